@@ -0,0 +1,77 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// a small harness in the spirit of gtest's. a benchmark loops on next(), and
+// the runner keeps doubling how many times until a run is long enough to
+// trust, then reports the time per iteration
+class bench_state {
+public:
+	typedef std::chrono::steady_clock clock;
+
+	explicit bench_state(size_t iterations) : iterations(iterations) {}
+
+	// the first call starts the clock, so setup before the loop is free
+	bool next() {
+		if (done == 0) begin = clock::now();
+		if (done++ < iterations) return true;
+
+		end = clock::now();
+		return false;
+	}
+
+	// for setup that has to happen inside the loop
+	void pause() { paused_at = clock::now(); }
+	void resume() { paused += clock::now() - paused_at; }
+
+	// work per iteration, reported as a rate alongside the time
+	void set_items(size_t n) { items = n; }
+	void set_bytes(size_t n) { bytes = n; }
+
+	clock::duration elapsed() const { return end - begin - paused; }
+
+	size_t iterations;
+	size_t items = 0, bytes = 0;
+
+private:
+	size_t done = 0;
+	clock::time_point begin, end, paused_at;
+	clock::duration paused = clock::duration::zero();
+};
+
+typedef std::function<void(bench_state&)> bench_function;
+
+struct bench_registrar {
+	bench_registrar(const std::string &name, bench_function f);
+};
+
+#define BENCH_NAME(group, name) bench_ ## group ## _ ## name
+#define BENCH(group, name) \
+	static void BENCH_NAME(group, name)(bench_state&); \
+	static bench_registrar BENCH_NAME(group, name ## _registrar)( \
+		#group "." #name, BENCH_NAME(group, name) \
+	); \
+	static void BENCH_NAME(group, name)(bench_state &state)
+
+// keeps the compiler from throwing away work whose result isn't used
+template <typename T>
+inline void keep(const T &value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// the scripts the compiler benchmarks run on. --corpus=dir reads every .gml
+// file in dir, and otherwise they're generated, the same way every time
+struct corpus_script {
+	std::string name;
+	std::string code;
+};
+
+const std::vector<corpus_script> &corpus();
+size_t corpus_bytes();
+
+#endif
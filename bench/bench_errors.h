@@ -0,0 +1,29 @@
+#ifndef BENCH_ERRORS_H
+#define BENCH_ERRORS_H
+
+#include <dejavu/compiler/error_stream.h>
+#include <cstdio>
+
+// the corpus should compile, so any error is a bug in it or in the compiler.
+// only the first is printed, since a benchmark hits the same one every time
+struct bench_errors : public error_stream {
+	void set_context(const std::string &c) { context = c; }
+	int count() { return errors; }
+
+	void error(const unexpected_token_error &e) { report("unexpected token"); }
+	void error(const redefinition_error &e) { report("redefinition of " + e.name); }
+	void error(const unsupported_error &e) { report(e.name + " is not supported"); }
+	void error(const std::string &e) { report(e); }
+
+	void progress(int i, const std::string &) {}
+
+private:
+	void report(const std::string &message) {
+		if (errors++ == 0) fprintf(stderr, "%s: %s\n", context.c_str(), message.c_str());
+	}
+
+	std::string context;
+	int errors = 0;
+};
+
+#endif
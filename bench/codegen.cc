@@ -0,0 +1,53 @@
+#include "bench.h"
+#include "bench_errors.h"
+#include <dejavu/compiler/parser.h>
+#include <dejavu/compiler/codegen.h>
+#include <dejavu/linker/linker.h>
+#include <dejavu/system/arena.h>
+#include <dejavu/system/buffer.h>
+#include <llvm/IR/LLVMContext.h>
+
+// parsed once up front, so this only measures generating code
+namespace {
+	struct parsed_corpus {
+		parsed_corpus() {
+			for (const corpus_script &s : corpus()) {
+				errors.set_context(s.name);
+
+				buffer code(s.code.size(), s.code.c_str());
+				token_stream tokens(code);
+				parser parser(tokens, allocator, errors);
+				programs.push_back(parser.getprogram());
+			}
+		}
+
+		bench_errors errors;
+		arena allocator;
+		std::vector<node*> programs;
+	};
+}
+
+static void generate(bench_state &state, bool optimize) {
+	llvm::LLVMContext context;
+	std::unique_ptr<llvm::Module> runtime(load_runtime(context));
+	parsed_corpus parsed;
+
+	state.set_bytes(corpus_bytes());
+	while (state.next()) {
+		node_codegen compiler(*runtime, parsed.errors);
+		compiler.set_optimize(optimize);
+		for (const corpus_script &s : corpus()) compiler.register_script(s.name);
+
+		for (size_t i = 0; i < parsed.programs.size(); i++) {
+			const corpus_script &s = corpus()[i];
+			parsed.errors.set_context(s.name);
+			keep(compiler.add_function(parsed.programs[i], s.name.c_str(), 0, true));
+		}
+
+		// tearing the module down is part of generating it
+		keep(compiler.take_module());
+	}
+}
+
+BENCH(codegen, generate) { generate(state, false); }
+BENCH(codegen, generate_optimized) { generate(state, true); }
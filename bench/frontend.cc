@@ -0,0 +1,56 @@
+#include "bench.h"
+#include "bench_errors.h"
+#include <dejavu/compiler/parser.h>
+#include <dejavu/system/arena.h>
+#include <dejavu/system/buffer.h>
+
+BENCH(frontend, lex) {
+	state.set_bytes(corpus_bytes());
+	while (state.next()) {
+		for (const corpus_script &s : corpus()) {
+			buffer code(s.code.size(), s.code.c_str());
+			token_stream tokens(code);
+			while (tokens.gettoken().type != eof);
+		}
+	}
+}
+
+BENCH(frontend, parse) {
+	bench_errors errors;
+	arena allocator;
+
+	state.set_bytes(corpus_bytes());
+	while (state.next()) {
+		for (const corpus_script &s : corpus()) {
+			errors.set_context(s.name);
+
+			buffer code(s.code.size(), s.code.c_str());
+			token_stream tokens(code);
+			parser parser(tokens, allocator, errors);
+			keep(parser.getprogram());
+
+			allocator.reset();
+		}
+	}
+}
+
+// what the linker does with scripts past stream_size
+BENCH(frontend, parse_statements) {
+	bench_errors errors;
+	arena allocator;
+
+	state.set_bytes(corpus_bytes());
+	while (state.next()) {
+		for (const corpus_script &s : corpus()) {
+			errors.set_context(s.name);
+
+			buffer code(s.code.size(), s.code.c_str());
+			token_stream tokens(code);
+			parser parser(tokens, allocator, errors);
+			while (statement *stmt = parser.getnext()) {
+				keep(stmt);
+				allocator.reset();
+			}
+		}
+	}
+}
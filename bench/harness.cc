@@ -0,0 +1,172 @@
+#include "bench.h"
+#include <dirent.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+	struct registered {
+		std::string name;
+		bench_function run;
+	};
+
+	std::vector<registered> &benchmarks() {
+		static std::vector<registered> benchmarks;
+		return benchmarks;
+	}
+
+	std::string corpus_path;
+	std::vector<corpus_script> scripts;
+}
+
+bench_registrar::bench_registrar(const std::string &name, bench_function f) {
+	benchmarks().push_back(registered{ name, f });
+}
+
+// enough of each construct the compiler treats specially that no one phase
+// dominates, with names that vary so nothing gets to hit a cache
+static std::string generate_script(unsigned n) {
+	std::ostringstream s;
+	s	<< "// generated script " << n << "\n"
+		<< "var i, total, name_" << n << ";\n"
+		<< "total = argument0;\n"
+		<< "for (i = 0; i < 10; i += 1) {\n"
+		<< "\tif (i mod 2 == 0 && !done_" << n << ") total += i * 2\n"
+		<< "\telse total -= other.speed_" << n << ";\n"
+		<< "}\n"
+		<< "/* move towards the target, but only\n"
+		<< "   while it's far enough away */\n"
+		<< "with (obj_" << n % 16 << ") {\n"
+		<< "\tx = xprevious + hspeed;\n"
+		<< "\ty = y + vspeed div 2;\n"
+		<< "}\n"
+		<< "switch (state_" << n << ") {\n"
+		<< "case 0: name_" << n << " = \"idle\"; break;\n"
+		<< "case 1: name_" << n << " = \"walking\" + \" \" + string(total); break;\n"
+		<< "default: exit;\n"
+		<< "}\n"
+		<< "repeat (3) global.score_" << n % 8 << " += self.value;\n"
+		<< "while (total > 100) total = total / 2;\n"
+		<< "do { total -= 1 } until (total <= 0);\n"
+		<< "data_" << n << "[i, 2] = total;\n"
+		<< "return total + data_" << n << "[0, 2];\n";
+	return s.str();
+}
+
+static void load_corpus() {
+	if (corpus_path.empty()) {
+		for (unsigned n = 0; n < 256; n++) {
+			std::ostringstream name;
+			name << "scr_" << n;
+			scripts.push_back(corpus_script{ name.str(), generate_script(n) });
+		}
+		return;
+	}
+
+	DIR *dir = opendir(corpus_path.c_str());
+	if (!dir) {
+		fprintf(stderr, "unable to open %s\n", corpus_path.c_str());
+		exit(1);
+	}
+
+	while (dirent *entry = readdir(dir)) {
+		std::string file = entry->d_name;
+		if (file.size() < 4 || file.compare(file.size() - 4, 4, ".gml") != 0)
+			continue;
+
+		std::ifstream in(corpus_path + "/" + file);
+		std::ostringstream code;
+		code << in.rdbuf();
+		scripts.push_back(corpus_script{ file.substr(0, file.size() - 4), code.str() });
+	}
+	closedir(dir);
+
+	// directory order isn't stable
+	std::sort(scripts.begin(), scripts.end(), [](
+		const corpus_script &a, const corpus_script &b
+	) {
+		return a.name < b.name;
+	});
+}
+
+const std::vector<corpus_script> &corpus() {
+	if (scripts.empty()) load_corpus();
+	return scripts;
+}
+
+size_t corpus_bytes() {
+	size_t bytes = 0;
+	for (const corpus_script &s : corpus()) bytes += s.code.size();
+	return bytes;
+}
+
+static void print_string(const std::string &s) {
+	putchar('"');
+	for (char c : s) {
+		if (c == '"' || c == '\\') putchar('\\');
+		putchar(c);
+	}
+	putchar('"');
+}
+
+// one json object per line, so results from different commits can be
+// collected with cat and compared with anything that reads json
+int main(int argc, char *argv[]) {
+	std::string filter, label;
+	double min_time = 0.2;
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if (strncmp(arg, "--filter=", 9) == 0) filter = arg + 9;
+		else if (strncmp(arg, "--label=", 8) == 0) label = arg + 8;
+		else if (strncmp(arg, "--corpus=", 9) == 0) corpus_path = arg + 9;
+		else if (strncmp(arg, "--min-time=", 11) == 0) min_time = atof(arg + 11);
+		else {
+			fprintf(stderr,
+				"usage: %s [--filter=substring] [--label=name] "
+				"[--corpus=dir] [--min-time=seconds]\n", argv[0]
+			);
+			return 1;
+		}
+	}
+
+	std::sort(benchmarks().begin(), benchmarks().end(), [](
+		const registered &a, const registered &b
+	) {
+		return a.name < b.name;
+	});
+
+	for (const registered &b : benchmarks()) {
+		if (b.name.find(filter) == std::string::npos) continue;
+
+		size_t iterations = 1;
+		double seconds;
+		bench_state result(0);
+		while (true) {
+			bench_state state(iterations);
+			b.run(state);
+			seconds = std::chrono::duration<double>(state.elapsed()).count();
+			result = state;
+
+			if (seconds >= min_time || iterations >= (1u << 30)) break;
+
+			// aim a little past min_time, but never grow by more than 10x
+			double scale = seconds > 0 ? 1.4 * min_time / seconds : 10;
+			iterations = std::max(iterations + 1, (size_t)(iterations * std::min(scale, 10.0)));
+		}
+
+		printf("{\"name\": "); print_string(b.name);
+		if (!label.empty()) { printf(", \"label\": "); print_string(label); }
+		printf(", \"iterations\": %zu, \"ns_per_iteration\": %.1f",
+			result.iterations, seconds * 1e9 / result.iterations);
+		if (result.items)
+			printf(", \"items_per_second\": %.0f", result.items * result.iterations / seconds);
+		if (result.bytes)
+			printf(", \"bytes_per_second\": %.0f", result.bytes * result.iterations / seconds);
+		printf("}\n");
+		fflush(stdout);
+	}
+
+	return 0;
+}
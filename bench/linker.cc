@@ -0,0 +1,152 @@
+#include "bench.h"
+#include "bench_errors.h"
+#include <dejavu/linker/linker.h>
+#include <dejavu/linker/game.h>
+
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/ADT/SmallString.h>
+
+#include <ftw.h>
+#include <cstdio>
+
+// the corpus as a game with nothing but scripts, the way the plugin would
+// hand it over
+namespace {
+	struct corpus_game {
+		corpus_game() {
+			for (const corpus_script &s : corpus()) {
+				names.push_back(std::vector<char>(s.name.begin(), s.name.end()));
+				names.back().push_back('\0');
+				code.push_back(std::vector<char>(s.code.begin(), s.code.end()));
+				code.back().push_back('\0');
+			}
+
+			for (size_t i = 0; i < names.size(); i++) {
+				scripts.push_back(script{ (unsigned)i, names[i].data(), code[i].data() });
+			}
+
+			source.version = 800;
+			source.name = name;
+			source.nscripts = scripts.size();
+			source.scripts = scripts.data();
+		}
+
+		game source = {};
+		char name[6] = "bench";
+		std::vector<std::vector<char>> names, code;
+		std::vector<script> scripts;
+	};
+
+	// a native target machine, set up the way the driver does it
+	struct native_target {
+		native_target() {
+			llvm::InitializeNativeTarget();
+			llvm::InitializeNativeTargetAsmPrinter();
+
+			std::string triple = llvm::sys::getDefaultTargetTriple(), error;
+			const llvm::Target *t = llvm::TargetRegistry::lookupTarget(triple, error);
+			if (!t) {
+				fprintf(stderr, "%s\n", error.c_str());
+				exit(1);
+			}
+
+			machine.reset(t->createTargetMachine(
+				triple, llvm::sys::getHostCPUName(), "", llvm::TargetOptions(),
+				llvm::Reloc::PIC_, llvm::CodeModel::Default,
+				llvm::CodeGenOpt::Aggressive
+			));
+		}
+
+		std::unique_ptr<llvm::TargetMachine> machine;
+	};
+
+	llvm::TargetMachine &target() {
+		static native_target native;
+		return *native.machine;
+	}
+
+	int remove_entry(const char *path, const struct stat *, int, struct FTW *) {
+		return remove(path);
+	}
+
+	// a fresh output directory, so nothing comes from the build cache
+	struct scratch_directory {
+		scratch_directory() {
+			llvm::sys::fs::createUniqueDirectory("dejavu-bench", path);
+		}
+		~scratch_directory() {
+			nftw(path.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+		}
+
+		llvm::SmallString<128> path;
+	};
+}
+
+static bool build(
+	const char *output, corpus_game &game, bench_errors &errors,
+	llvm::Module &runtime, const build_config &config
+) {
+	std::string object = std::string(output) + "/game.o";
+	return linker(output, game.source, errors, runtime, target()).build(
+		object.c_str(), config, emit_object
+	);
+}
+
+static void build_cold(bench_state &state, const build_config &config) {
+	llvm::LLVMContext context;
+	std::unique_ptr<llvm::Module> runtime(load_runtime(context));
+	corpus_game game;
+	bench_errors errors;
+	target();
+
+	state.set_bytes(corpus_bytes());
+	while (state.next()) {
+		state.pause();
+		{
+			scratch_directory output;
+			state.resume();
+			keep(build(output.path.c_str(), game, errors, *runtime, config));
+			state.pause();
+		}
+		state.resume();
+	}
+}
+
+// the second build of an unchanged game, which is the edit-run loop once
+// every unit is cached. what's left is linking and emitting
+static void build_cached(bench_state &state, const build_config &config) {
+	llvm::LLVMContext context;
+	std::unique_ptr<llvm::Module> runtime(load_runtime(context));
+	corpus_game game;
+	bench_errors errors;
+	scratch_directory output;
+	build(output.path.c_str(), game, errors, *runtime, config);
+
+	state.set_bytes(corpus_bytes());
+	while (state.next()) {
+		keep(build(output.path.c_str(), game, errors, *runtime, config));
+	}
+}
+
+static build_config release() {
+	return build_config();
+}
+
+static build_config run() {
+	build_config config;
+	config.opt = opt_o1;
+	config.lto = false;
+	return config;
+}
+
+BENCH(linker, cold) { build_cold(state, release()); }
+BENCH(linker, cold_run) { build_cold(state, run()); }
+BENCH(linker, cached) { build_cached(state, release()); }
+BENCH(linker, cached_run) { build_cached(state, run()); }
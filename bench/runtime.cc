@@ -0,0 +1,120 @@
+#include "bench.h"
+#include <dejavu/runtime/variant.h>
+
+// what game.cc would otherwise provide
+string_pool strings;
+arena frame;
+
+#define BINARY_OPS(X) \
+	X(less) X(less_equals) X(is_equals) X(not_equals) \
+	X(greater_equals) X(greater) \
+	X(plus) X(minus) X(times) X(divide) \
+	X(log_and) X(log_or) X(log_xor) \
+	X(bit_and) X(bit_or) X(bit_xor) X(shift_left) X(shift_right) \
+	X(div_) X(mod)
+
+#define UNARY_OPS(X) X(not_) X(inv) X(neg) X(pos)
+
+// the operators aren't in a header, since only generated code calls them
+extern "C" {
+#define DECLARE_BINARY(op) variant op(variant *a, variant *b);
+#define DECLARE_UNARY(op) variant op(variant *a);
+	BINARY_OPS(DECLARE_BINARY)
+	UNARY_OPS(DECLARE_UNARY)
+}
+
+// one benchmark per operator, on the reals every operator takes
+static const size_t op_count = 1024;
+
+static std::vector<variant> operands() {
+	std::vector<variant> values;
+	for (size_t i = 0; i < op_count; i++) values.push_back(variant(1.0 + i % 7));
+	return values;
+}
+
+static void register_binary(const char *name, variant (*op)(variant*, variant*)) {
+	bench_registrar(std::string("binary.") + name, [op](bench_state &state) {
+		std::vector<variant> a = operands(), b = operands();
+		state.set_items(op_count);
+		while (state.next()) {
+			for (size_t i = 0; i < op_count; i++) keep(op(&a[i], &b[op_count - 1 - i]));
+		}
+	});
+}
+
+static void register_unary(const char *name, variant (*op)(variant*)) {
+	bench_registrar(std::string("unary.") + name, [op](bench_state &state) {
+		std::vector<variant> a = operands();
+		state.set_items(op_count);
+		while (state.next()) {
+			for (size_t i = 0; i < op_count; i++) keep(op(&a[i]));
+		}
+	});
+}
+
+static bool registered = [] {
+#define REGISTER_BINARY(op) register_binary(#op, op);
+#define REGISTER_UNARY(op) register_unary(#op, op);
+	BINARY_OPS(REGISTER_BINARY)
+	UNARY_OPS(REGISTER_UNARY)
+	return true;
+}();
+
+// the string paths, which are the only ones that allocate
+BENCH(binary, plus_string) {
+	variant a = strings.intern("some_prefix_"), b = strings.intern("suffix");
+	a.string->retain(); b.string->retain();
+
+	state.set_items(op_count);
+	while (state.next()) {
+		for (size_t i = 0; i < op_count; i++) {
+			variant r = plus(&a, &b);
+			release(&r);
+		}
+		frame.reset();
+	}
+}
+
+BENCH(binary, is_equals_string) {
+	variant a = strings.intern("some_prefix_"), b = strings.intern("suffix");
+	a.string->retain(); b.string->retain();
+
+	state.set_items(op_count);
+	while (state.next()) {
+		for (size_t i = 0; i < op_count; i++) keep(is_equals(&a, &b));
+	}
+}
+
+static const unsigned array_size = 4096;
+
+// filling an array in order, which is what grow's geometric capacity is for
+BENCH(access, grow_row) {
+	state.set_items(array_size);
+	while (state.next()) {
+		var v = {};
+		for (unsigned i = 0; i < array_size; i++) *access_var(&v, i, 0, true) = (double)i;
+		release_var(&v);
+	}
+}
+
+BENCH(access, grow_grid) {
+	state.set_items(64 * 64);
+	while (state.next()) {
+		var v = {};
+		for (unsigned y = 0; y < 64; y++) {
+			for (unsigned x = 0; x < 64; x++) *access_var(&v, x, y, true) = (double)x;
+		}
+		release_var(&v);
+	}
+}
+
+BENCH(access, read) {
+	var v = {};
+	for (unsigned i = 0; i < array_size; i++) *access_var(&v, i, 0, true) = (double)i;
+
+	state.set_items(array_size);
+	while (state.next()) {
+		for (unsigned i = 0; i < array_size; i++) keep(access_var(&v, i, 0, false));
+	}
+	release_var(&v);
+}
@@ -0,0 +1,183 @@
+#include "bench.h"
+#include <dejavu/system/table.h>
+#include <dejavu/system/string.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+template<>
+struct hash<unsigned> {
+	size_t operator()(unsigned x) const { return x * 2654435761u; }
+};
+
+template<>
+struct equal<unsigned> {
+	bool operator()(unsigned x, unsigned y) const { return x == y; }
+};
+
+static const unsigned table_size = 1 << 16;
+
+BENCH(table, insert) {
+	state.set_items(table_size);
+	while (state.next()) {
+		table<unsigned, unsigned> t;
+		for (unsigned i = 0; i < table_size; i++) t.insert(i) = i;
+		keep(t.size());
+	}
+}
+
+BENCH(table, insert_reserved) {
+	state.set_items(table_size);
+	while (state.next()) {
+		table<unsigned, unsigned> t;
+		t.reserve(table_size);
+		for (unsigned i = 0; i < table_size; i++) t.insert(i) = i;
+		keep(t.size());
+	}
+}
+
+// what every scope's dynamic table goes through
+template <size_t small>
+static void small_tables(bench_state &state) {
+	static const unsigned tables = 1024;
+	state.set_items(tables);
+	while (state.next()) {
+		for (unsigned i = 0; i < tables; i++) {
+			table<unsigned, unsigned, hash<unsigned>, equal<unsigned>, small> t;
+			t[i] = 1;
+			t[i + 1] = 2;
+			keep(t.find(i));
+		}
+	}
+}
+
+BENCH(table, small_heap) { small_tables<0>(state); }
+BENCH(table, small_inline) { small_tables<2>(state); }
+
+BENCH(table, find) {
+	table<unsigned, unsigned> t;
+	for (unsigned i = 0; i < table_size; i++) t.insert(i) = i;
+
+	state.set_items(table_size);
+	while (state.next()) {
+		for (unsigned i = 0; i < table_size; i++) keep(t.find(i));
+	}
+}
+
+BENCH(table, find_missing) {
+	table<unsigned, unsigned> t;
+	for (unsigned i = 0; i < table_size; i++) t.insert(i) = i;
+
+	state.set_items(table_size);
+	while (state.next()) {
+		for (unsigned i = table_size; i < 2 * table_size; i++) keep(t.find(i));
+	}
+}
+
+BENCH(table, remove) {
+	state.set_items(table_size);
+	while (state.next()) {
+		state.pause();
+		table<unsigned, unsigned> t;
+		for (unsigned i = 0; i < table_size; i++) t.insert(i) = i;
+		state.resume();
+
+		for (unsigned i = 0; i < table_size; i++) t.remove(i);
+		keep(t.size());
+	}
+}
+
+static std::vector<std::string> names(size_t n) {
+	std::vector<std::string> names;
+	for (size_t i = 0; i < n; i++) {
+		names.push_back("some_fairly_long_prefix_" + std::to_string(i));
+	}
+	return names;
+}
+
+BENCH(string_pool, intern) {
+	std::vector<std::string> strs = names(table_size);
+
+	state.set_items(strs.size());
+	while (state.next()) {
+		string_pool pool;
+		for (const std::string &s : strs) keep(pool.intern(s.data(), s.size()));
+	}
+}
+
+BENCH(string_pool, intern_existing) {
+	std::vector<std::string> strs = names(table_size);
+	string_pool pool;
+	for (const std::string &s : strs) pool.intern(s.data(), s.size())->retain();
+
+	state.set_items(strs.size());
+	while (state.next()) {
+		for (const std::string &s : strs) keep(pool.intern(s.data(), s.size()));
+	}
+}
+
+// strings that are already built, like the result of a concatenation
+static std::vector<string*> temporaries(const std::vector<std::string> &names) {
+	std::vector<string*> strs;
+	for (const std::string &name : names) {
+		strs.push_back(new (name.size()) string(name.size(), name.data()));
+	}
+	return strs;
+}
+
+BENCH(string_pool, intern_temporary) {
+	std::vector<string*> strs = temporaries(names(table_size));
+
+	state.set_items(strs.size());
+	while (state.next()) {
+		string_pool pool;
+		for (string *s : strs) keep(pool.intern_temporary(s));
+	}
+
+	for (string *s : strs) delete s;
+}
+
+namespace {
+	struct empty {};
+
+	struct contents_equal {
+		bool operator()(const string *a, const string *b) const {
+			return
+				a->hash == b->hash && a->length == b->length &&
+				memcmp(a->data, b->data, a->length) == 0;
+		}
+	};
+}
+
+// how strings were interned before the pool, for comparison with
+// intern_temporary
+BENCH(string_pool, table_baseline) {
+	std::vector<string*> strs = temporaries(names(table_size));
+
+	state.set_items(strs.size());
+	while (state.next()) {
+		table<string*, empty, hash<string*>, contents_equal> t;
+		for (string *s : strs) {
+			if (t.find(s) == t.end()) t.insert(s);
+		}
+		keep(t.size());
+	}
+
+	for (string *s : strs) delete s;
+}
+
+static void bench_hash(bench_state &state, size_t length) {
+	std::string data(length, 'x');
+	for (size_t i = 0; i < length; i++) data[i] = 'a' + i % 26;
+
+	state.set_bytes(length);
+	while (state.next()) {
+		keep(data);
+		keep(string::compute_hash(data.size(), data.data()));
+	}
+}
+
+BENCH(compute_hash, 8) { bench_hash(state, 8); }
+BENCH(compute_hash, 24) { bench_hash(state, 24); }
+BENCH(compute_hash, 256) { bench_hash(state, 256); }
+BENCH(compute_hash, 4096) { bench_hash(state, 4096); }
@@ -0,0 +1,130 @@
+#include "driver.h"
+#include <dejavu/linker/project_file.h>
+#include <dejavu/linker/game.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// everything the plugin would show in its progress pane, on stderr
+class stderr_log : public build_log {
+public:
+	stderr_log(const std::string &project, bool timings) :
+		project(project), timings(timings) {}
+
+	void append(const char *text) { fputs(text, stderr); }
+	void message(const char *text) {
+		fprintf(stderr, "%s: %s\n", project.c_str(), text);
+	}
+
+	void timing(
+		const char *phase, const char *unit, double start, double seconds,
+		size_t bytes, size_t instructions, unsigned thread
+	) {
+		if (!timings) return;
+
+		fprintf(stderr, "%s: %8.3fms %s%s%s", project.c_str(), seconds * 1e3,
+			phase, *unit ? " " : "", unit);
+		if (bytes) fprintf(stderr, ", %zu bytes", bytes);
+		if (instructions) fprintf(stderr, ", %zu instructions", instructions);
+		fputs("\n", stderr);
+	}
+
+private:
+	std::string project;
+	bool timings;
+};
+
+static int usage(const char *name) {
+	fprintf(stderr,
+		"usage: %s [options] project.djv...\n"
+		"\n"
+		"builds each project into an executable next to it, with its build\n"
+		"cache in a .build directory beside that\n"
+		"\n"
+		"  -o target         the executable, for a single project\n"
+		"  --output=dir      the build directory, for a single project\n"
+		"  --run             run the game instead of writing an executable\n"
+		"  -O0 -O1 -O2 -O3 -Os\n"
+		"  --no-lto          don't optimize the game and runtime together\n"
+		"  --cpu=name        a cpu to tune for, or native\n"
+		"  --features=list   cpu features, like +avx2,-sse4a\n"
+		"  --threads=n       parallel compile jobs, 0 for one per core\n"
+		"  --profile=mode    instrument or use\n"
+		"  --trace           write trace.json to the build directory\n"
+		"  --timings         print how long each phase took\n",
+		name
+	);
+	return 2;
+}
+
+// foo.djv builds to foo, caching in foo.build
+static std::string stem(const std::string &path) {
+	size_t slash = path.rfind('/');
+	size_t dot = path.rfind('.');
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		return path.substr(0, dot);
+	return path + ".out";
+}
+
+int main(int argc, char *argv[]) {
+	build_config config;
+	std::string target, output;
+	bool run = false, timings = false;
+	std::vector<std::string> projects;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if (strcmp(arg, "-o") == 0 && i + 1 < argc) target = argv[++i];
+		else if (strncmp(arg, "--output=", 9) == 0) output = arg + 9;
+		else if (strcmp(arg, "--run") == 0) run = true;
+		else if (strcmp(arg, "-O0") == 0) config.opt = opt_o0;
+		else if (strcmp(arg, "-O1") == 0) config.opt = opt_o1;
+		else if (strcmp(arg, "-O2") == 0) config.opt = opt_o2;
+		else if (strcmp(arg, "-O3") == 0) config.opt = opt_o3;
+		else if (strcmp(arg, "-Os") == 0) config.opt = opt_os;
+		else if (strcmp(arg, "--no-lto") == 0) config.lto = false;
+		else if (strncmp(arg, "--cpu=", 6) == 0) config.cpu = arg + 6;
+		else if (strncmp(arg, "--features=", 11) == 0) config.features = arg + 11;
+		else if (strncmp(arg, "--threads=", 10) == 0) config.threads = atoi(arg + 10);
+		else if (strcmp(arg, "--profile=instrument") == 0) config.profile = profile_instrument;
+		else if (strcmp(arg, "--profile=use") == 0) config.profile = profile_use;
+		else if (strcmp(arg, "--trace") == 0) config.trace = true;
+		else if (strcmp(arg, "--timings") == 0) timings = true;
+		else if (arg[0] == '-') return usage(argv[0]);
+		else projects.push_back(arg);
+	}
+
+	if (projects.empty()) return usage(argv[0]);
+	if (projects.size() > 1 && (!target.empty() || !output.empty() || run)) {
+		fprintf(stderr, "-o, --output and --run take a single project\n");
+		return 2;
+	}
+
+	// one session for every project, so llvm only warms up once
+	session backend;
+
+	int failed = 0;
+	for (const std::string &project : projects) {
+		project_file file;
+		if (int error = file.open_file(project.c_str())) {
+			fprintf(stderr, "%s: %s\n", project.c_str(),
+				error == EINVAL ? "not a dejavu project" : strerror(error));
+			failed++;
+			continue;
+		}
+
+		std::string t = !target.empty() ? target : stem(project);
+		std::string o = !output.empty() ? output : stem(project) + ".build";
+
+		stderr_log log(project, timings);
+		bool success = run ?
+			backend.run(o.c_str(), file.get(), log, config) :
+			backend.compile(o.c_str(), t.c_str(), file.get(), log, config);
+		if (!success) failed++;
+	}
+
+	return failed > 0 ? 1 : 0;
+}
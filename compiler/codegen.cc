@@ -3,14 +3,20 @@
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DataLayout.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
 #include <tuple>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
 #include <sstream>
 
 using namespace llvm;
 
 node_codegen::node_codegen(const Module &runtime, error_stream &e) :
-	runtime(runtime), dl(&runtime),
-	builder(runtime.getContext()), module("", runtime.getContext()), errors(e) {
+	runtime(runtime), dl(&runtime), builder(runtime.getContext()), errors(e) {
 
 	scope_type = runtime.getTypeByName("struct.scope")->getPointerTo();
 	var_type = runtime.getTypeByName("struct.var");
@@ -20,65 +26,184 @@ node_codegen::node_codegen(const Module &runtime, error_stream &e) :
 
 	real_type = builder.getDoubleTy();
 	string_type = runtime.getTypeByName("struct.string")->getPointerTo();
+	cache_type = runtime.getTypeByName("struct.lookup_cache");
+	iterator_type = runtime.getTypeByName("struct.with_iterator");
 
 	union_diff =
 		dl.getTypeAllocSize(real_type) - dl.getTypeAllocSize(string_type);
 
+	types.set_scripts(&scripts);
+	create_module();
+}
+
+std::unique_ptr<Module> node_codegen::take_module() {
+	intern_literals();
+	register_profiles();
+	if (passes) passes->doFinalization();
+
+	std::unique_ptr<Module> m = std::move(module);
+	create_module();
+	return m;
+}
+
+// every literal points at its own constant until this runs at load time and
+// swaps in the interned string, so evaluating one is just a load
+void node_codegen::intern_literals() {
+	if (string_literals.empty()) return;
+
+	Function *init = Function::Create(
+		FunctionType::get(builder.getVoidTy(), false),
+		Function::InternalLinkage, "intern_literals", module.get()
+	);
+	builder.SetInsertPoint(BasicBlock::Create(module->getContext(), "entry", init));
+
+	for (auto &literal : string_literals) {
+		GlobalVariable *ptr = literal.getValue();
+		builder.CreateStore(
+			builder.CreateCall(intern_literal, builder.CreateLoad(ptr)), ptr
+		);
+	}
+	builder.CreateRetVoid();
+
+	// the runtime's string pool is constructed before this, at priority 101.
+	// the jit ignores priorities, so the linker sorts the constructors for it
+	appendToGlobalCtors(*module, init, 65535);
+}
+
+void node_codegen::set_profile(profile_mode mode, const profile_data *data) {
+	profile = mode;
+	profile_source = mode == profile_use ? data : 0;
+
+	// anything called at least an eighth as often as the busiest function is
+	// worth inlining
+	hot_calls = 1;
+	if (profile_source) {
+		for (auto &entry : *profile_source) {
+			if (!entry.second.empty())
+				hot_calls = std::max(hot_calls, entry.second[0] / 8);
+		}
+	}
+}
+
+// instrumented functions hand their counters to the runtime at load time,
+// and it writes them all out when the game exits
+void node_codegen::register_profiles() {
+	if (profiled.empty()) return;
+
+	Function *init = Function::Create(
+		FunctionType::get(builder.getVoidTy(), false),
+		Function::InternalLinkage, "register_profiles", module.get()
+	);
+	builder.SetInsertPoint(BasicBlock::Create(module->getContext(), "entry", init));
+
+	for (GlobalVariable *counters : profiled) {
+		StringRef name = counters->getName().substr(strlen("profile."));
+		builder.CreateCall3(
+			profile_register, builder.CreateGlobalStringPtr(name),
+			builder.CreateBitCast(counters, builder.getInt64Ty()->getPointerTo()),
+			builder.getInt32(counters->getType()->getElementType()->getArrayNumElements())
+		);
+	}
+	builder.CreateRetVoid();
+
+	appendToGlobalCtors(*module, init, 65535);
+	profiled.clear();
+}
+
+void node_codegen::set_optimize(bool o) {
+	optimize = o;
+	create_passes();
+}
+
+// just enough to undo what codegen leaves lying around: every local and
+// temporary is an alloca, and most branches are on constants or redundant
+// type checks. anything interprocedural waits for the linked module
+void node_codegen::create_passes() {
+	passes.reset();
+	if (!optimize) return;
+
+	passes = std::make_unique<FunctionPassManager>(module.get());
+	passes->add(new DataLayoutPass());
+	passes->add(createPromoteMemoryToRegisterPass());
+	passes->add(createSROAPass());
+	passes->add(createInstructionCombiningPass());
+	passes->add(createCFGSimplificationPass());
+	passes->doInitialization();
+}
+
+void node_codegen::create_module() {
+	module = std::make_unique<Module>("", runtime.getContext());
+	module->setDataLayout(runtime.getDataLayout());
+	string_literals.clear();
+	profiled.clear();
+	create_passes();
+
 	// todo: create a gml calling convention for the runtime
 	to_real = Function::Create(
 		runtime.getFunction("to_real")->getFunctionType(),
-		Function::ExternalLinkage, "to_real", &module
+		Function::ExternalLinkage, "to_real", module.get()
 	);
 	to_string = Function::Create(
 		runtime.getFunction("to_string")->getFunctionType(),
-		Function::ExternalLinkage, "to_string", &module
+		Function::ExternalLinkage, "to_string", module.get()
+	);
+	intern_literal = Function::Create(
+		runtime.getFunction("intern_literal")->getFunctionType(),
+		Function::ExternalLinkage, "intern_literal", module.get()
 	);
-	intern = Function::Create(
-		runtime.getFunction("intern")->getFunctionType(),
-		Function::ExternalLinkage, "intern", &module
+	profile_register = Function::Create(
+		runtime.getFunction("profile_register")->getFunctionType(),
+		Function::ExternalLinkage, "profile_register", module.get()
 	);
-	access = Function::Create(
-		runtime.getFunction("access")->getFunctionType(),
-		Function::ExternalLinkage, "access", &module
+	access_var = Function::Create(
+		runtime.getFunction("access_var")->getFunctionType(),
+		Function::ExternalLinkage, "access_var", module.get()
 	);
 	retain = Function::Create(
 		runtime.getFunction("retain")->getFunctionType(),
-		Function::ExternalLinkage, "retain", &module
+		Function::ExternalLinkage, "retain", module.get()
 	);
 	release = Function::Create(
 		runtime.getFunction("release")->getFunctionType(),
-		Function::ExternalLinkage, "release", &module
+		Function::ExternalLinkage, "release", module.get()
 	);
 	retain_var = Function::Create(
 		runtime.getFunction("retain_var")->getFunctionType(),
-		Function::ExternalLinkage, "retain_var", &module
+		Function::ExternalLinkage, "retain_var", module.get()
+	);
+	append = Function::Create(
+		runtime.getFunction("append")->getFunctionType(),
+		Function::ExternalLinkage, "append", module.get()
 	);
 	release_var = Function::Create(
 		runtime.getFunction("release_var")->getFunctionType(),
-		Function::ExternalLinkage, "release_var", &module
+		Function::ExternalLinkage, "release_var", module.get()
 	);
 	insert_globalvar = Function::Create(
-		runtime.getFunction("insert_globalvar")->getFunctionType(),
-		Function::ExternalLinkage, "insert_globalvar", &module
+		runtime.getFunction("insert_globalvar_slot")->getFunctionType(),
+		Function::ExternalLinkage, "insert_globalvar_slot", module.get()
 	);
 	lookup_default = Function::Create(
-		runtime.getFunction("lookup_default")->getFunctionType(),
-		Function::ExternalLinkage, "lookup_default", &module
+		runtime.getFunction("lookup_default_slot")->getFunctionType(),
+		Function::ExternalLinkage, "lookup_default_slot", module.get()
 	);
 	lookup = Function::Create(
-		runtime.getFunction("lookup")->getFunctionType(),
-		Function::ExternalLinkage, "lookup", &module
+		runtime.getFunction("lookup_cached")->getFunctionType(),
+		Function::ExternalLinkage, "lookup_cached", module.get()
+	);
+	scope_epoch = new GlobalVariable(
+		*module, builder.getInt32Ty(), false,
+		GlobalValue::ExternalLinkage, nullptr, "scope_epoch"
 	);
 
-	// todo: implement these
-	/*with_begin = Function::Create(
+	with_begin = Function::Create(
 		runtime.getFunction("with_begin")->getFunctionType(),
-		Function::ExternalLinkage, "with_begin", &module
+		Function::ExternalLinkage, "with_begin", module.get()
 	);
 	with_inc = Function::Create(
 		runtime.getFunction("with_inc")->getFunctionType(),
-		Function::ExternalLinkage, "with_inc", &module
-	);*/
+		Function::ExternalLinkage, "with_inc", module.get()
+	);
 }
 
 namespace {
@@ -96,12 +221,96 @@ namespace {
 
 Function *node_codegen::add_function(
 	node *body, const char *name, size_t nargs, bool var
+) {
+	Function *function = start_function(body, name, nargs, var);
+	if (!function) return get_function(name, nargs, var);
+
+	visit(body);
+	end_function();
+	return function;
+}
+
+Function *node_codegen::begin_function(
+	const char *name, size_t nargs, bool var
+) {
+	return start_function(0, name, nargs, var);
+}
+
+// argv is copied into an array of the script's arity first, so arguments past
+// argc are 0 like visit_call passes them, and nothing reads past argv
+Function *node_codegen::add_entry(StringRef name, StringRef script) {
+	auto it = scripts.find(script);
+	if (it == scripts.end()) return 0;
+	const script_signature &sig = it->second;
+
+	Type *vargs[] = {
+		scope_type, scope_type, builder.getInt16Ty(), variant_type->getPointerTo()
+	};
+	Function *entry = Function::Create(
+		FunctionType::get(ret_type, vargs, false),
+		Function::ExternalLinkage, name, module.get()
+	);
+	Function::arg_iterator ai = entry->arg_begin();
+	Value *self = ai, *other = ++ai, *argc = ++ai, *argv = ++ai;
+
+	builder.SetInsertPoint(BasicBlock::Create(module->getContext(), "entry", entry));
+	std::vector<Value*> args = { self, other, argc };
+	if (!sig.fixed) {
+		args.push_back(argv);
+	}
+	else if (sig.arity > 0) {
+		uint64_t size = dl.getTypeAllocSize(variant_type);
+		Value *array = builder.CreateAlloca(
+			variant_type, builder.getInt32(sig.arity), "argument"
+		);
+		builder.CreateMemSet(array, builder.getInt8(0), size * sig.arity, 0);
+
+		Value *count = builder.CreateZExt(argc, builder.getInt64Ty());
+		Value *arity = builder.getInt64(sig.arity);
+		count = builder.CreateSelect(
+			builder.CreateICmpULT(count, arity), count, arity
+		);
+		builder.CreateMemCpy(
+			array, argv, builder.CreateMul(count, builder.getInt64(size)), 0
+		);
+
+		for (unsigned i = 0; i < sig.arity; i++) {
+			Value *indices[] = { builder.getInt32(i) };
+			args.push_back(builder.CreateLoad(builder.CreateBitCast(
+				builder.CreateInBoundsGEP(array, indices),
+				ret_type->getPointerTo()
+			)));
+		}
+	}
+
+	Value *ret = builder.CreateCall(get_function(script, 0, true), args);
+	if (sig.real) {
+		Value *result = builder.CreateAlloca(variant_type);
+		builder.CreateStore(builder.getInt8(0), type_ptr(result));
+		builder.CreateStore(ret, real_ptr(result));
+		ret = builder.CreateLoad(
+			builder.CreateBitCast(result, ret_type->getPointerTo())
+		);
+	}
+	builder.CreateRet(ret);
+
+	return entry;
+}
+
+void node_codegen::add_statement(statement *stmt) {
+	visit(stmt);
+}
+
+// body is only for analysis- generating it is up to the caller
+Function *node_codegen::start_function(
+	node *body, const char *name, size_t nargs, bool var
 ) {
 	Function *function = get_function(name, nargs, var);
 	if (!function->empty()) {
 		errors.error(redefinition_error(name));
-		return function;
+		return 0;
 	}
+	current_function = function;
 
 	// this is not reentrant. it would need to save the state of:
 	// return, scopes, insertion point, and symbol table
@@ -111,7 +320,9 @@ Function *node_codegen::add_function(
 
 	BasicBlock *entry = BasicBlock::Create(function->getContext());
 
+	types.analyze(body, var);
 	scope.clear();
+	reals.clear();
 	alloca_point = new BitCastInst(
 		builder.getInt32(0), builder.getInt32Ty(), "alloca", entry
 	);
@@ -121,36 +332,183 @@ Function *node_codegen::add_function(
 	function->getBasicBlockList().push_back(entry);
 	builder.SetInsertPoint(entry);
 
+	// running off the end returns 0
+	script_signature sig;
+	if (var && scripts.count(name)) sig = scripts[name];
+	returns_real = var && sig.real;
+	builder.CreateStore(builder.getInt8(0), type_ptr(return_value));
+	builder.CreateStore(ConstantFP::get(real_type, 0), real_ptr(return_value));
+
+	// the counters aren't sized until every branch has been generated
+	profile_sites = 0;
+	profile_counters = 0;
+	profile_counts = 0;
+	if (profile == profile_instrument) {
+		ArrayType *type = ArrayType::get(builder.getInt64Ty(), 0);
+		profile_counters = new GlobalVariable(
+			*module, type, false, GlobalValue::InternalLinkage,
+			ConstantAggregateZero::get(type)
+		);
+
+		Value *indices[] = { builder.getInt32(0), builder.getInt32(0) };
+		increment(builder.CreateInBoundsGEP(profile_counters, indices));
+	}
+	else if (profile_source) {
+		auto it = profile_source->find(name);
+		if (it != profile_source->end() && !it->second.empty()) {
+			profile_counts = &it->second;
+
+			uint64_t calls = it->second[0];
+			if (calls == 0) function->addFnAttr(Attribute::Cold);
+			else if (calls >= hot_calls) function->addFnAttr(Attribute::InlineHint);
+		}
+	}
+
 	if (var) {
 		Value *arg_count = ++ai;
-		Value *arg_array = ++ai;
 
-		scope["argument_count"] = make_local("argument_count", get_real(
-			builder.CreateUIToFP(arg_count, builder.getDoubleTy())
-		));
+		reals["argument_count"] = alloc(real_type, "argument_count");
+		builder.CreateStore(
+			builder.CreateUIToFP(arg_count, real_type), reals["argument_count"]
+		);
+
+		// a fixed script gets its arguments by value, and keeps them in an
+		// array of its own for argument to borrow. arguments past argc are
+		// just out of bounds, as they would be in the caller's array
+		Value *count = builder.CreateZExt(arg_count, builder.getInt32Ty());
+		Value *arg_array;
+		if (sig.fixed) {
+			arg_array = alloc(
+				variant_type, builder.getInt32(sig.arity), "argument"
+			);
+			for (unsigned i = 0; i < sig.arity; i++) {
+				Value *indices[] = { builder.getInt32(i) };
+				builder.CreateStore(++ai, builder.CreateBitCast(
+					builder.CreateInBoundsGEP(arg_array, indices),
+					ret_type->getPointerTo()
+				));
+			}
+
+			Value *arity = builder.getInt32(sig.arity);
+			count = builder.CreateSelect(
+				builder.CreateICmpULT(count, arity), count, arity
+			);
+		}
+		else {
+			arg_array = ++ai;
+		}
+
 		scope["argument"] = make_local(
-			"argument", arg_count, builder.getInt16(1), arg_array
+			"argument", count, builder.getInt32(1), arg_array
 		);
 
 		// todo: accessors for argument# (also for builtin locals)
 	}
 
-	visit(body);
+	return function;
+}
+
+void node_codegen::end_function() {
+	Function *function = current_function;
+	current_function = 0;
 
+	// argument only holds references once something has been stored to it
 	for (
 		std::unordered_map<std::string, Value*>::iterator it = scope.begin();
 		it != scope.end(); ++it
 	) {
-		if (it->first == "argument_count" || it->first == "argument")
-			continue;
-
 		builder.CreateCall(release_var, it->second);
 	}
 
-	Value *ret = builder.CreateLoad(builder.CreateBitCast(return_value, ret_type->getPointerTo()));
-	builder.CreateRet(ret);
+	return_default();
 
-	return function;
+	if (profile_counters) {
+		ArrayType *type = ArrayType::get(builder.getInt64Ty(), 1 + 2 * profile_sites);
+		GlobalVariable *counters = new GlobalVariable(
+			*module, type, false, GlobalValue::InternalLinkage,
+			ConstantAggregateZero::get(type), "profile." + function->getName()
+		);
+		profile_counters->replaceAllUsesWith(
+			ConstantExpr::getBitCast(counters, profile_counters->getType())
+		);
+		profile_counters->eraseFromParent();
+		profiled.push_back(counters);
+	}
+
+	// broken functions are left for the linker to report
+	if (passes && !verifyFunction(*function)) passes->run(*function);
+}
+
+void node_codegen::return_default() {
+	if (returns_real) {
+		builder.CreateRet(builder.CreateLoad(real_ptr(return_value)));
+		return;
+	}
+
+	Value *ptr = builder.CreateBitCast(return_value, ret_type->getPointerTo());
+	builder.CreateRet(builder.CreateLoad(ptr));
+}
+
+void node_codegen::increment(Value *counter) {
+	Value *n = builder.CreateLoad(counter);
+	builder.CreateStore(builder.CreateAdd(n, builder.getInt64(1)), counter);
+}
+
+// branch weights only have 32 bits. the + 1 keeps a branch that was never
+// taken from looking impossible, and can't wrap in 64 bits
+static uint32_t scale_weight(uint64_t n, uint64_t max) {
+	if (max > UINT32_MAX) n = n / (max / UINT32_MAX + 1);
+	return std::min<uint64_t>(n + 1, UINT32_MAX);
+}
+
+// every conditional branch the source controls comes through here, so an
+// instrumented build can count which way it goes and a profiled one can say
+// which way it's likely to go
+BranchInst *node_codegen::branch(Value *cond, BasicBlock *t, BasicBlock *f) {
+	unsigned site = profile_sites++;
+	if (profile_counters) {
+		Value *indices[] = {
+			builder.getInt32(0),
+			builder.CreateAdd(
+				builder.getInt32(1 + 2 * site),
+				builder.CreateZExt(cond, builder.getInt32Ty())
+			)
+		};
+		increment(builder.CreateInBoundsGEP(profile_counters, indices));
+	}
+
+	BranchInst *br = builder.CreateCondBr(cond, t, f);
+
+	// a stale profile just runs out of counters
+	if (profile_counts && 2 + 2 * site < profile_counts->size()) {
+		uint64_t not_taken = (*profile_counts)[1 + 2 * site];
+		uint64_t taken = (*profile_counts)[2 + 2 * site];
+		uint64_t max = std::max(taken, not_taken);
+
+		br->setMetadata(LLVMContext::MD_prof, MDBuilder(br->getContext()).createBranchWeights(
+			scale_weight(taken, max), scale_weight(not_taken, max)
+		));
+	}
+
+	return br;
+}
+
+static double constant_real(const token &t) {
+	switch (t.type) {
+	default: return 0;
+
+	case v_real: return t.real;
+
+	case kw_self: return -1;
+	case kw_other: return -2;
+	case kw_all: return -3;
+	case kw_noone: return -4;
+	case kw_global: return -5;
+	case kw_local: return -6;
+
+	case kw_true: return 1;
+	case kw_false: return 0;
+	}
 }
 
 Value *node_codegen::visit_value(value *v) {
@@ -159,37 +517,31 @@ Value *node_codegen::visit_value(value *v) {
 
 	case v_name: {
 		std::string name(v->t.string.data, v->t.string.length);
+		if (reals.find(name) != reals.end())
+			return get_real(builder.CreateLoad(reals[name]));
+
 		Value *var = scope.find(name) != scope.end() ? scope[name] :
-			do_lookup_default(
-				builder.CreateCall(
-					to_string,
-					get_string(StringRef(v->t.string.data, v->t.string.length))
-				),
-				lvalue
-			);
+			do_lookup_default(get_slot(name), lvalue);
 		return builder.CreateCall4(
-			access, var,
-			builder.getInt16(0), builder.getInt16(0), builder.getInt1(lvalue)
+			access_var, var,
+			builder.getInt32(0), builder.getInt32(0), builder.getInt1(lvalue)
 		);
 	}
 
-	case v_real: return get_real(v->t.real);
 	case v_string:
 		return get_string(StringRef(v->t.string.data, v->t.string.length));
 
-	case kw_self: return get_real(-1);
-	case kw_other: return get_real(-2);
-	case kw_all: return get_real(-3);
-	case kw_noone: return get_real(-4);
-	case kw_global: return get_real(-5);
-	case kw_local: return get_real(-6);
-
-	case kw_true: return get_real(1);
-	case kw_false: return get_real(0.0);
+	case v_real:
+	case kw_self: case kw_other: case kw_all:
+	case kw_noone: case kw_global: case kw_local:
+	case kw_true: case kw_false:
+		return get_real(constant_real(v->t));
 	}
 }
 
 Value *node_codegen::visit_unary(unary *u) {
+	if (types.is_real(u)) return get_real(visit_real(u));
+
 	const char *name;
 	switch (u->op) {
 	default: return 0;
@@ -203,13 +555,40 @@ Value *node_codegen::visit_unary(unary *u) {
 	Value *operand = alloc(variant_type);
 	builder.CreateMemCpy(operand, visit(u->right), dl.getTypeStoreSize(variant_type), 0);
 
+	Function *f = builder.GetInsertBlock()->getParent();
+	BasicBlock *fast = BasicBlock::Create(f->getContext(), "fast");
+	BasicBlock *slow = BasicBlock::Create(f->getContext(), "slow");
+	BasicBlock *merge = BasicBlock::Create(f->getContext(), "merge");
+
+	Value *is_real = builder.CreateICmpEQ(
+		builder.CreateLoad(type_ptr(operand)), builder.getInt8(0)
+	);
+	branch(is_real, fast, slow);
+
+	f->getBasicBlockList().push_back(fast);
+	builder.SetInsertPoint(fast);
+	builder.CreateStore(builder.getInt8(0), type_ptr(result));
+	builder.CreateStore(
+		real_unary(u->op, builder.CreateLoad(real_ptr(operand))), real_ptr(result)
+	);
+	builder.CreateBr(merge);
+
+	f->getBasicBlockList().push_back(slow);
+	builder.SetInsertPoint(slow);
 	CallInst *call = builder.CreateCall(get_operator(name, 1), operand);
 	Value *ret = builder.CreateBitCast(result, ret_type->getPointerTo());
 	builder.CreateStore(call, ret);
+	builder.CreateBr(merge);
+
+	f->getBasicBlockList().push_back(merge);
+	builder.SetInsertPoint(merge);
+
 	return result;
 }
 
 Value *node_codegen::visit_binary(binary *b) {
+	if (types.is_real(b)) return get_real(visit_real(b));
+
 	const char *name;
 	switch (b->op) {
 	default: return 0;
@@ -217,16 +596,12 @@ Value *node_codegen::visit_binary(binary *b) {
 	case dot: {
 		token &name = static_cast<value*>(b->right)->t;
 		Value *var = do_lookup(
-			builder.CreateCall(to_real, visit(b->left)),
-			builder.CreateCall(
-				to_string,
-				get_string(StringRef(name.string.data, name.string.length))
-			),
-			lvalue
+			as_real(b->left),
+			get_slot(StringRef(name.string.data, name.string.length)), lvalue
 		);
 		return builder.CreateCall4(
-			access, var,
-			builder.getInt16(0), builder.getInt16(0), builder.getInt1(lvalue)
+			access_var, var,
+			builder.getInt32(0), builder.getInt32(0), builder.getInt1(lvalue)
 		);
 	}
 
@@ -263,9 +638,37 @@ Value *node_codegen::visit_binary(binary *b) {
 	builder.CreateMemCpy(left, visit(b->left), dl.getTypeStoreSize(variant_type), 0);
 	builder.CreateMemCpy(right, visit(b->right), dl.getTypeStoreSize(variant_type), 0);
 
+	// real-real is by far the common case, so it's checked for inline and only
+	// everything else goes through the runtime's dispatch table
+	Function *f = builder.GetInsertBlock()->getParent();
+	BasicBlock *fast = BasicBlock::Create(f->getContext(), "fast");
+	BasicBlock *slow = BasicBlock::Create(f->getContext(), "slow");
+	BasicBlock *merge = BasicBlock::Create(f->getContext(), "merge");
+
+	Value *both_real = builder.CreateICmpEQ(builder.CreateOr(
+		builder.CreateLoad(type_ptr(left)), builder.CreateLoad(type_ptr(right))
+	), builder.getInt8(0));
+	branch(both_real, fast, slow);
+
+	f->getBasicBlockList().push_back(fast);
+	builder.SetInsertPoint(fast);
+	builder.CreateStore(builder.getInt8(0), type_ptr(result));
+	builder.CreateStore(real_binary(
+		b->op,
+		builder.CreateLoad(real_ptr(left)), builder.CreateLoad(real_ptr(right))
+	), real_ptr(result));
+	builder.CreateBr(merge);
+
+	f->getBasicBlockList().push_back(slow);
+	builder.SetInsertPoint(slow);
 	CallInst *call = builder.CreateCall2(get_operator(name, 2), left, right);
 	Value *ret = builder.CreateBitCast(result, ret_type->getPointerTo());
 	builder.CreateStore(call, ret);
+	builder.CreateBr(merge);
+
+	f->getBasicBlockList().push_back(merge);
+	builder.SetInsertPoint(merge);
+
 	return result;
 }
 
@@ -277,13 +680,8 @@ Value *node_codegen::visit_subscript(subscript *s) {
 	case value_node: {
 		value *v = static_cast<value*>(s->array);
 		std::string name(v->t.string.data, v->t.string.length);
-		var = scope.find(name) != scope.end() ? scope[name] : do_lookup_default(
-			builder.CreateCall(
-				to_string,
-				get_string(StringRef(v->t.string.data, v->t.string.length))
-			),
-			lvalue
-		);
+		var = scope.find(name) != scope.end() ? scope[name] :
+			do_lookup_default(get_slot(name), lvalue);
 		break;
 	}
 
@@ -291,85 +689,167 @@ Value *node_codegen::visit_subscript(subscript *s) {
 		binary *left = static_cast<binary*>(s->array);
 		token &name = static_cast<value*>(left->right)->t;
 		var = do_lookup(
-			builder.CreateCall(to_real, visit(left->left)),
-			builder.CreateCall(
-				to_string,
-				get_string(StringRef(name.string.data, name.string.length))
-			),
-			lvalue
+			as_real(left->left),
+			get_slot(StringRef(name.string.data, name.string.length)), lvalue
 		);
 		break;
 	}
 	}
 
-	std::vector<Value*> indices(2, builder.getInt16(0));
+	std::vector<Value*> indices(2, builder.getInt32(0));
 	for (size_t i = 0; i < s->indices.size(); i++) {
 		Value *index = builder.CreateFPToUI(
-			builder.CreateCall(to_real, visit(s->indices[i])),
-			builder.getInt16Ty()
+			as_real(s->indices[i]), builder.getInt32Ty()
 		);
 		indices[i] = index;
 	}
 
 	return builder.CreateCall4(
-		access, var, indices[0], indices[1], builder.getInt1(lvalue)
+		access_var, var, indices[0], indices[1], builder.getInt1(lvalue)
 	);
 }
 
+// scripts take their arguments as an array, or by value when they're fixed,
+// but everything else has a fixed arity and gets a pointer straight to each one
 Value *node_codegen::visit_call(call *c) {
+	Value *ret = emit_call(c);
+	if (ret->getType() == real_type) return get_real(ret);
+
 	StringRef name(c->function->t.string.data, c->function->t.string.length);
-	bool var = scripts.find(name) != scripts.end();
+	Value *result = alloc(variant_type, name + "_ret");
+	builder.CreateStore(
+		ret, builder.CreateBitCast(result, ret_type->getPointerTo())
+	);
+	return result;
+}
+
+Value *node_codegen::emit_call(call *c) {
+	StringRef name(c->function->t.string.data, c->function->t.string.length);
+	auto it = scripts.find(name);
+	bool var = it != scripts.end();
+	script_signature sig;
+	if (var) sig = it->second;
 
 	Function *function = get_function(name, var ? 0 : c->args.size(), var);
 
 	std::vector<Value*> args;
-	args.reserve(c->args.size() + 4);
-
-	// todo: make & use new GML LLVM cc
-	Value *result = alloc(variant_type, name + "_ret");
+	args.reserve(c->args.size() + sig.arity + 4);
 
 	args.push_back(self_scope);
 	args.push_back(other_scope);
 	if (var) args.push_back(builder.getInt16(c->args.size()));
 
-	Value *array = alloc(
-		variant_type, builder.getInt32(c->args.size()), name + "_args"
-	);
-	for (size_t i = 0; i < c->args.size(); i++) {
-		Value *indices[] = { builder.getInt32(i) };
-		Value *arg = builder.CreateInBoundsGEP(array, indices);
-		builder.CreateMemCpy(
-			arg, visit(c->args[i]), dl.getTypeStoreSize(variant_type), 0
+	Value *array = 0;
+	if (var && !sig.fixed) {
+		array = alloc(
+			variant_type, builder.getInt32(c->args.size()), name + "_args"
 		);
+	}
+	for (size_t i = 0; i < c->args.size(); i++) {
+		Value *value = visit(c->args[i]);
+
+		// a fixed script never looks past its arity, but every argument is
+		// still evaluated
+		if (sig.fixed) {
+			if (i < sig.arity) args.push_back(builder.CreateLoad(
+				builder.CreateBitCast(value, ret_type->getPointerTo())
+			));
+			continue;
+		}
+
+		// temporaries can be passed as they are, but a variable could change
+		// under the callee
+		Value *arg = value;
+		if (var) {
+			Value *indices[] = { builder.getInt32(i) };
+			arg = builder.CreateInBoundsGEP(array, indices);
+		}
+		else if (in_variable(c->args[i])) {
+			arg = alloc(variant_type, name + "_arg");
+		}
 
+		if (arg != value) {
+			builder.CreateMemCpy(
+				arg, value, dl.getTypeStoreSize(variant_type), 0
+			);
+		}
 		if (!var) args.push_back(arg);
 	}
-	if (var) args.push_back(array);
+	for (size_t i = c->args.size(); i < sig.arity; i++) {
+		args.push_back(Constant::getNullValue(ret_type));
+	}
+	if (array) args.push_back(array);
 
-	CallInst *call = builder.CreateCall(function, args);
-	Value *ret = builder.CreateBitCast(result, ret_type->getPointerTo());
-	builder.CreateStore(call, ret);
-	return result;
+	return builder.CreateCall(function, args);
 }
 
 Value *node_codegen::visit_assignment(assignment *a) {
+	if (
+		a->lvalue->type == value_node &&
+		static_cast<value*>(a->lvalue)->t.type == v_name
+	) {
+		token &t = static_cast<value*>(a->lvalue)->t;
+		auto it = reals.find(std::string(t.string.data, t.string.length));
+		if (it != reals.end()) {
+			Value *r;
+			if (a->op == equals) {
+				r = visit_real(a->rvalue);
+			}
+			else {
+				binary b(compound_op(a->op), a->lvalue, a->rvalue);
+				r = visit_real(&b);
+			}
+
+			builder.CreateStore(r, it->second);
+			return 0;
+		}
+	}
+
+	if (expression *e = get_append(a)) {
+		Value *r = copy_variable(e, visit(e));
+
+		Value *l;
+		{
+			save_context<bool> save(lvalue);
+			lvalue = true;
+			l = visit(a->lvalue);
+		}
+
+		// the same inline guard as visit_binary, so only strings pay for the
+		// call
+		Function *f = builder.GetInsertBlock()->getParent();
+		BasicBlock *fast = BasicBlock::Create(f->getContext(), "fast");
+		BasicBlock *slow = BasicBlock::Create(f->getContext(), "slow");
+		BasicBlock *merge = BasicBlock::Create(f->getContext(), "merge");
+
+		Value *both_real = builder.CreateICmpEQ(builder.CreateOr(
+			builder.CreateLoad(type_ptr(l)), builder.CreateLoad(type_ptr(r))
+		), builder.getInt8(0));
+		branch(both_real, fast, slow);
+
+		f->getBasicBlockList().push_back(fast);
+		builder.SetInsertPoint(fast);
+		builder.CreateStore(builder.CreateFAdd(
+			builder.CreateLoad(real_ptr(l)), builder.CreateLoad(real_ptr(r))
+		), real_ptr(l));
+		builder.CreateBr(merge);
+
+		f->getBasicBlockList().push_back(slow);
+		builder.SetInsertPoint(slow);
+		builder.CreateCall2(append, l, r);
+		builder.CreateBr(merge);
+
+		f->getBasicBlockList().push_back(merge);
+		builder.SetInsertPoint(merge);
+		return 0;
+	}
+
 	Value *r;
 	if (a->op == equals) {
-		r = visit(a->rvalue);
+		r = copy_variable(a->rvalue, visit(a->rvalue));
 	}
 	else {
-		token_type op = unexpected;
-		switch (a->op) {
-		case plus_equals: op = plus; break;
-		case minus_equals: op = minus; break;
-		case times_equals: op = times; break;
-		case div_equals: op = divide; break;
-		case and_equals: op = bit_and; break;
-		case or_equals: op = bit_or; break;
-		case xor_equals: op = bit_xor; break;
-		default: /* should've already errored */ break;
-		}
-		binary b(op, a->lvalue, a->rvalue);
+		binary b(compound_op(a->op), a->lvalue, a->rvalue);
 		r = visit_binary(&b);
 	}
 
@@ -382,31 +862,105 @@ Value *node_codegen::visit_assignment(assignment *a) {
 
 	builder.CreateCall(release, l);
 	builder.CreateMemCpy(l, r, dl.getTypeStoreSize(variant_type), 0);
-	builder.CreateCall(retain, l);
+	if (!is_owned(a) && !types.is_real(a->rvalue))
+		builder.CreateCall(retain, l);
 	return 0;
 }
 
+// s += e and s = s + e grow s in place in the runtime, behind a check for
+// two reals. appending something that's known to be a real is left to the
+// inline real path instead
+expression *node_codegen::get_append(assignment *a) {
+	expression *e = 0;
+	if (a->op == plus_equals) {
+		e = a->rvalue;
+	}
+	else if (
+		a->op == equals && a->rvalue->type == binary_node &&
+		static_cast<binary*>(a->rvalue)->op == plus
+	) {
+		binary *b = static_cast<binary*>(a->rvalue);
+		if (
+			a->lvalue->type == value_node && b->left->type == value_node &&
+			static_cast<value*>(a->lvalue)->t.type == v_name &&
+			static_cast<value*>(b->left)->t.type == v_name
+		) {
+			token &l = static_cast<value*>(a->lvalue)->t;
+			token &r = static_cast<value*>(b->left)->t;
+			if (
+				l.string.length == r.string.length &&
+				memcmp(l.string.data, r.string.data, l.string.length) == 0
+			)
+				e = b->right;
+		}
+	}
+
+	if (!e || types.is_real(e)) return 0;
+	return e;
+}
+
+// whether visiting e gives a pointer into a variable rather than a temporary
+bool node_codegen::in_variable(expression *e) {
+	switch (e->type) {
+	case value_node: {
+		token &t = static_cast<value*>(e)->t;
+		return
+			t.type == v_name &&
+			reals.find(std::string(t.string.data, t.string.length)) == reals.end();
+	}
+
+	case subscript_node: return true;
+	case binary_node: return static_cast<binary*>(e)->op == dot;
+	default: return false;
+	}
+}
+
+// visiting an lvalue can grow and move the array an rvalue points into, as
+// in a[n] += a[0], so anything still in a variable is copied out first
+Value *node_codegen::copy_variable(expression *e, Value *value) {
+	if (!in_variable(e)) return value;
+
+	Value *copy = alloc(variant_type, "rvalue");
+	builder.CreateMemCpy(copy, value, dl.getTypeStoreSize(variant_type), 0);
+	return copy;
+}
+
+// operator results are fresh temporaries that already hold their reference
+// (see plus_string_string), so storing one moves it rather than copying it
+bool node_codegen::is_owned(assignment *a) {
+	if (a->op != equals) return true;
+
+	switch (a->rvalue->type) {
+	case unary_node: return true;
+	case binary_node: return static_cast<binary*>(a->rvalue)->op != dot;
+	default: return false;
+	}
+}
+
 Value *node_codegen::visit_invocation(invocation* i) {
 	visit(i->c);
 	return 0;
 }
 
 Value *node_codegen::visit_declaration(declaration *d) {
-	for (
-		std::vector<value*>::iterator it = d->names.begin();
-		it != d->names.end(); ++it
-	) {
-		std::string name((*it)->t.string.data, (*it)->t.string.length);
+	for (value *v : d->names) {
+		std::string name(v->t.string.data, v->t.string.length);
 
 		if (name == "argument" || name == "argument_count") {
 			errors.error(redefinition_error(name));
 			continue;
 		}
 		if (d->type.type == kw_globalvar) {
-			builder.CreateCall(
-				insert_globalvar,
-				builder.CreateCall(to_string, get_string(name))
-			);
+			builder.CreateCall(insert_globalvar, get_slot(name));
+			continue;
+		}
+
+		// real locals are plain doubles. they start at 0 rather than undefined
+		if (types.is_real(name)) {
+			if (reals.find(name) == reals.end())
+				reals[name] = alloc(real_type, name);
+
+			builder.CreateStore(ConstantFP::get(real_type, 0), reals[name]);
 			continue;
 		}
 
@@ -423,8 +977,8 @@ Value *node_codegen::visit_declaration(declaration *d) {
 }
 
 Value *node_codegen::visit_block(block *b) {
-	for (std::vector<statement*>::iterator it = b->stmts.begin(); it != b->stmts.end(); ++it) {
-		visit(*it);
+	for (statement *stmt : b->stmts) {
+		visit(stmt);
 	}
 
 	return 0;
@@ -436,7 +990,7 @@ Value *node_codegen::visit_ifstatement(ifstatement *i) {
 	BasicBlock *branch_false = BasicBlock::Create(f->getContext(), "else");
 	BasicBlock *merge = BasicBlock::Create(f->getContext(), "merge");
 
-	builder.CreateCondBr(to_bool(i->cond), branch_true, branch_false);
+	branch(to_bool(i->cond), branch_true, branch_false);
 
 	f->getBasicBlockList().push_back(branch_true);
 	builder.SetInsertPoint(branch_true);
@@ -465,7 +1019,7 @@ Value *node_codegen::visit_whilestatement(whilestatement *w) {
 
 	f->getBasicBlockList().push_back(cond);
 	builder.SetInsertPoint(cond);
-	builder.CreateCondBr(to_bool(w->cond), loop, after);
+	branch(to_bool(w->cond), loop, after);
 
 	f->getBasicBlockList().push_back(loop);
 	builder.SetInsertPoint(loop);
@@ -503,7 +1057,7 @@ Value *node_codegen::visit_dostatement(dostatement *d) {
 
 	f->getBasicBlockList().push_back(cond);
 	builder.SetInsertPoint(cond);
-	builder.CreateCondBr(to_bool(d->cond), after, loop);
+	branch(to_bool(d->cond), after, loop);
 
 	f->getBasicBlockList().push_back(after);
 	builder.SetInsertPoint(after);
@@ -514,31 +1068,34 @@ Value *node_codegen::visit_dostatement(dostatement *d) {
 Value *node_codegen::visit_repeatstatement(repeatstatement *r) {
 	Function *f = builder.GetInsertBlock()->getParent();
 	BasicBlock *loop = BasicBlock::Create(f->getContext(), "loop");
+	BasicBlock *step = BasicBlock::Create(f->getContext(), "step");
 	BasicBlock *after = BasicBlock::Create(f->getContext(), "after");
 	BasicBlock *init = builder.GetInsertBlock();
 
+	// the count is checked before the first iteration, so repeat (0) never
+	// runs. continue goes through step like it goes through a for's inc
+	// todo: check with GM's rounding behavior
 	Value *start = ConstantFP::get(builder.getDoubleTy(), 0);
-	Value *end = builder.CreateCall(to_real, visit(r->expr));
-	builder.CreateBr(loop);
+	Value *end = as_real(r->expr);
+	branch(builder.CreateFCmpOLT(start, end), loop, after);
 
 	f->getBasicBlockList().push_back(loop);
 	builder.SetInsertPoint(loop);
 	PHINode *inc = builder.CreatePHI(builder.getDoubleTy(), 2, "inc");
+	inc->addIncoming(start, init);
 	{
-		inc->addIncoming(start, init);
-
 		save_context<BasicBlock*, BasicBlock*> save(current_loop, current_end);
-		current_loop = loop;
+		current_loop = step;
 		current_end = after;
 		visit(r->stmt);
-
-		Value *next = builder.CreateFAdd(inc, ConstantFP::get(builder.getDoubleTy(), 1));
-		BasicBlock *last = builder.GetInsertBlock();
-		inc->addIncoming(next, last);
 	}
-	// todo: check with GM's rounding behavior
-	Value *done = builder.CreateFCmpULT(inc, end);
-	builder.CreateCondBr(done, loop, after);
+	builder.CreateBr(step);
+
+	f->getBasicBlockList().push_back(step);
+	builder.SetInsertPoint(step);
+	Value *next = builder.CreateFAdd(inc, ConstantFP::get(builder.getDoubleTy(), 1));
+	inc->addIncoming(next, step);
+	branch(builder.CreateFCmpOLT(next, end), loop, after);
 
 	f->getBasicBlockList().push_back(after);
 	builder.SetInsertPoint(after);
@@ -558,7 +1115,7 @@ Value *node_codegen::visit_forstatement(forstatement *f) {
 
 	fn->getBasicBlockList().push_back(cond);
 	builder.SetInsertPoint(cond);
-	builder.CreateCondBr(to_bool(f->cond), loop, after);
+	branch(to_bool(f->cond), loop, after);
 
 	fn->getBasicBlockList().push_back(loop);
 	builder.SetInsertPoint(loop);
@@ -590,8 +1147,11 @@ Value *node_codegen::visit_withstatement(withstatement *w) {
 	BasicBlock *after = BasicBlock::Create(f->getContext(), "after");
 
 	Value *with_expr = visit(w->expr);
+	Value *iterator = alloc(iterator_type, "with");
 	Value *instance = alloc(scope_type);
-	Value *init = builder.CreateCall3(with_begin, self_scope, other_scope, with_expr);
+	Value *init = builder.CreateCall4(
+		with_begin, iterator, self_scope, other_scope, with_expr
+	);
 	builder.CreateStore(init, instance);
 	builder.CreateBr(cond);
 
@@ -599,7 +1159,7 @@ Value *node_codegen::visit_withstatement(withstatement *w) {
 	builder.SetInsertPoint(cond);
 	Value *with_end = ConstantPointerNull::get(scope_type);
 	Value *with_cond = builder.CreateICmpNE(builder.CreateLoad(instance), with_end);
-	builder.CreateCondBr(with_cond, loop, after);
+	branch(with_cond, loop, after);
 
 	f->getBasicBlockList().push_back(loop);
 	builder.SetInsertPoint(loop);
@@ -617,9 +1177,7 @@ Value *node_codegen::visit_withstatement(withstatement *w) {
 
 	f->getBasicBlockList().push_back(inc);
 	builder.SetInsertPoint(inc);
-	Value *with_next = builder.CreateCall4(
-		with_inc, self_scope, other_scope, with_expr, builder.CreateLoad(instance)
-	);
+	Value *with_next = builder.CreateCall(with_inc, iterator);
 	builder.CreateStore(with_next, instance);
 	builder.CreateBr(cond);
 
@@ -629,7 +1187,61 @@ Value *node_codegen::visit_withstatement(withstatement *w) {
 	return 0;
 }
 
-// todo: switch on a hash rather than generating an if/else chain
+// a case label is either dispatched on, tested in the chain without
+// affecting dispatch (a constant that can't match anything dispatched), or
+// evaluated, which means nothing after it can be dispatched
+enum case_kind { case_dynamic, case_constant, case_real, case_string };
+
+static case_kind constant_case(expression *e, double &real, StringRef &str) {
+	bool negate = false;
+	if (e->type == unary_node && static_cast<unary*>(e)->op == minus) {
+		e = static_cast<unary*>(e)->right;
+		negate = true;
+	}
+	if (e->type != value_node) return case_dynamic;
+
+	token &t = static_cast<value*>(e)->t;
+	switch (t.type) {
+	case v_string:
+		if (negate) return case_dynamic;
+		str = StringRef(t.string.data, t.string.length);
+		return case_string;
+
+	case v_real:
+	case kw_self: case kw_other: case kw_all:
+	case kw_noone: case kw_global: case kw_local:
+	case kw_true: case kw_false:
+		real = negate ? -constant_real(t) : constant_real(t);
+		if (!(real >= INT32_MIN && real <= INT32_MAX) || real != (int32_t)real)
+			return case_constant;
+		return case_real;
+
+	default:
+		return case_dynamic;
+	}
+}
+
+static bool has_constant_cases(switchstatement *s) {
+	for (statement *stmt : s->stmts->stmts) {
+		if (stmt->type != casestatement_node) continue;
+
+		casestatement *c = static_cast<casestatement*>(stmt);
+		if (!c->expr) continue;
+
+		double real; StringRef str;
+		switch (constant_case(c->expr, real, str)) {
+		case case_real: case case_string: return true;
+		case case_dynamic: return false;
+		case case_constant: continue;
+		}
+	}
+
+	return false;
+}
+
+// constant labels go in an llvm switch on the value's integer part, or on a
+// string's hash followed by a pointer comparison. everything else (and any
+// value the switches miss) falls through to an if/else chain
 Value *node_codegen::visit_switchstatement(switchstatement *s) {
 	Function *f = builder.GetInsertBlock()->getParent();
 	BasicBlock *switch_default = BasicBlock::Create(f->getContext(), "default");
@@ -637,18 +1249,95 @@ Value *node_codegen::visit_switchstatement(switchstatement *s) {
 	BasicBlock *after = BasicBlock::Create(f->getContext(), "after");
 
 	Value *switch_expr = visit(s->expr);
+
+	SwitchInst *switch_reals = 0, *switch_strings = 0;
+	Value *switch_string = 0;
+	if (has_constant_cases(s)) {
+		BasicBlock *chain = BasicBlock::Create(f->getContext(), "chain", f);
+		BasicBlock *real_check = BasicBlock::Create(f->getContext(), "real", f);
+		BasicBlock *real_int = BasicBlock::Create(f->getContext(), "int", f);
+		BasicBlock *real_switch = BasicBlock::Create(f->getContext(), "reals", f);
+		BasicBlock *string_check = BasicBlock::Create(f->getContext(), "string", f);
+		BasicBlock *string_switch = BasicBlock::Create(f->getContext(), "strings", f);
+
+		SwitchInst *type = builder.CreateSwitch(
+			builder.CreateLoad(type_ptr(switch_expr)), chain, 2
+		);
+		type->addCase(builder.getInt8(0), real_check);
+		type->addCase(builder.getInt8(1), string_check);
+
+		// fptosi is undefined out of range, and the round trip catches fractions
+		builder.SetInsertPoint(real_check);
+		Value *real = builder.CreateLoad(real_ptr(switch_expr));
+		Value *in_range = builder.CreateAnd(
+			builder.CreateFCmpOGE(real, ConstantFP::get(real_type, INT32_MIN)),
+			builder.CreateFCmpOLE(real, ConstantFP::get(real_type, INT32_MAX))
+		);
+		builder.CreateCondBr(in_range, real_int, chain);
+
+		builder.SetInsertPoint(real_int);
+		Value *integer = builder.CreateFPToSI(real, builder.getInt32Ty());
+		Value *exact = builder.CreateFCmpOEQ(
+			builder.CreateSIToFP(integer, real_type), real
+		);
+		builder.CreateCondBr(exact, real_switch, chain);
+
+		builder.SetInsertPoint(real_switch);
+		switch_reals = builder.CreateSwitch(integer, chain);
+
+		// builders don't have a hash yet, and aren't the literal even when
+		// they match it, so they're interned first
+		BasicBlock *string_intern = BasicBlock::Create(f->getContext(), "intern", f);
+
+		builder.SetInsertPoint(string_check);
+		Value *sindices[] = { builder.getInt32(0), builder.getInt32(1) };
+		Value *str = builder.CreateLoad(builder.CreateBitCast(
+			builder.CreateInBoundsGEP(switch_expr, sindices),
+			string_type->getPointerTo()
+		));
+		Value *capacity = builder.CreateLoad(builder.CreateStructGEP(str, 4));
+		builder.CreateCondBr(
+			builder.CreateIsNull(capacity), string_switch, string_intern
+		);
+
+		builder.SetInsertPoint(string_intern);
+		Value *interned = builder.CreateCall(get_operator("intern", 1), str);
+		builder.CreateBr(string_switch);
+
+		builder.SetInsertPoint(string_switch);
+		PHINode *canonical = builder.CreatePHI(str->getType(), 2);
+		canonical->addIncoming(str, string_check);
+		canonical->addIncoming(interned, string_intern);
+		switch_string = canonical;
+
+		switch_strings = builder.CreateSwitch(
+			builder.CreateLoad(builder.CreateStructGEP(canonical, 2)), chain
+		);
+
+		builder.SetInsertPoint(chain);
+	}
+
 	Function::iterator switch_cond = builder.GetInsertBlock();
 
 	f->getBasicBlockList().push_back(dead);
 	builder.SetInsertPoint(dead);
 	{
-		save_context<Value*, BasicBlock*, Function::iterator, BasicBlock*> save(
-			current_switch, current_default, current_cond, current_end
+		save_context<
+			Value*, BasicBlock*, Function::iterator, BasicBlock*,
+			SwitchInst*, SwitchInst*, Value*,
+			std::unordered_map<uint64_t, BranchInst*>
+		> save(
+			current_switch, current_default, current_cond, current_end,
+			current_reals, current_strings, current_string, current_hashes
 		);
 		current_switch = switch_expr;
 		current_default = switch_default;
 		current_cond = switch_cond;
 		current_end = after;
+		current_reals = switch_reals;
+		current_strings = switch_strings;
+		current_string = switch_string;
+		current_hashes.clear();
 		visit(s->stmts);
 
 		builder.SetInsertPoint(current_cond);
@@ -682,16 +1371,57 @@ Value *node_codegen::visit_casestatement(casestatement *c) {
 	}
 
 	BasicBlock *switch_case = BasicBlock::Create(f->getContext(), "case");
-	BasicBlock *next_cond = BasicBlock::Create(f->getContext(), "next");
 
-	builder.SetInsertPoint(current_cond);
+	double real; StringRef str;
+	case_kind kind = current_reals ?
+		constant_case(c->expr, real, str) : case_dynamic;
+
+	if (kind == case_real) {
+		// the first of any duplicate labels wins, same as the chain
+		ConstantInt *label = builder.getInt32((int32_t)real);
+		if (current_reals->findCaseValue(label) == current_reals->case_default())
+			current_reals->addCase(label, switch_case);
+	}
+	else if (kind == case_string) {
+		// strings with the same hash get a chain of their own
+		BasicBlock *test = BasicBlock::Create(f->getContext(), "hash");
+		f->getBasicBlockList().insertAfter(
+			Function::iterator(current_strings->getParent()), test
+		);
+		ConstantInt *hash = cast<ConstantInt>(ConstantInt::get(
+			builder.getIntPtrTy(&dl), string::compute_hash(str.size(), str.data())
+		));
+
+		auto it = current_hashes.find(hash->getZExtValue());
+		if (it == current_hashes.end())
+			current_strings->addCase(hash, test);
+		else
+			it->second->setSuccessor(1, test);
+
+		builder.SetInsertPoint(test);
+		Value *cond = builder.CreateICmpEQ(current_string, get_literal(str));
+		current_hashes[hash->getZExtValue()] = builder.CreateCondBr(
+			cond, switch_case, current_strings->getDefaultDest()
+		);
+	}
+	else {
+		// nothing after this can skip ahead of it
+		if (kind == case_dynamic) {
+			current_reals = 0;
+			current_strings = 0;
+		}
+
+		BasicBlock *next_cond = BasicBlock::Create(f->getContext(), "next");
 
-	Value *case_expr = visit(c->expr);
-	Value *cond = is_equal(current_switch, case_expr);
-	builder.CreateCondBr(cond, switch_case, next_cond);
+		builder.SetInsertPoint(current_cond);
 
-	f->getBasicBlockList().insertAfter(current_cond, next_cond);
-	current_cond = next_cond;
+		Value *case_expr = visit(c->expr);
+		Value *cond = is_equal(current_switch, case_expr);
+		branch(cond, switch_case, next_cond);
+
+		f->getBasicBlockList().insertAfter(current_cond, next_cond);
+		current_cond = next_cond;
+	}
 
 	builder.SetInsertPoint(&f->getBasicBlockList().back());
 	builder.CreateBr(switch_case);
@@ -706,14 +1436,14 @@ Value *node_codegen::visit_jump(jump *j) {
 	switch (j->type) {
 	default: return 0;
 
-	case kw_exit: builder.CreateRet(builder.CreateLoad(return_value)); break;
+	case kw_exit: return_default(); break;
 	case kw_break:
 		if (current_end) builder.CreateBr(current_end);
-		else builder.CreateRet(builder.CreateLoad(return_value));
+		else return_default();
 		break;
 	case kw_continue:
 		if (current_loop) builder.CreateBr(current_loop);
-		else builder.CreateRet(builder.CreateLoad(return_value));
+		else return_default();
 		break;
 	}
 
@@ -725,9 +1455,14 @@ Value *node_codegen::visit_jump(jump *j) {
 }
 
 Value *node_codegen::visit_returnstatement(returnstatement *r) {
-	Value *ret = visit(r->expr);
-	Value *ptr = builder.CreateBitCast(ret, ret_type->getPointerTo());
-	builder.CreateRet(builder.CreateLoad(ptr));
+	if (returns_real) {
+		builder.CreateRet(as_real(r->expr));
+	}
+	else {
+		Value *ret = visit(r->expr);
+		Value *ptr = builder.CreateBitCast(ret, ret_type->getPointerTo());
+		builder.CreateRet(builder.CreateLoad(ptr));
+	}
 
 	Function *f = builder.GetInsertBlock()->getParent();
 	BasicBlock *cont = BasicBlock::Create(f->getContext(), "cont", f);
@@ -737,34 +1472,48 @@ Value *node_codegen::visit_returnstatement(returnstatement *r) {
 }
 
 Function *node_codegen::get_operator(StringRef name, int args) {
-	Function *function = module.getFunction(name);
+	Function *function = module->getFunction(name);
 	if (function) return function;
 
 	return Function::Create(
 		runtime.getFunction(name)->getFunctionType(),
-		Function::ExternalLinkage, name, &module
+		Function::ExternalLinkage, name, module.get()
 	);
 }
 
+// scripts take an argument count and then either an array or, for fixed
+// ones, each argument by value
 Function *node_codegen::get_function(StringRef name, int args, bool var) {
-	Function *function = module.getFunction(name);
+	Function *function = module->getFunction(name);
 	if (function) return function;
 
+	script_signature sig;
+	if (var && scripts.count(name)) sig = scripts[name];
+
 	std::vector<Type*> vargs(
 		args + (var ? 4 : 2), variant_type->getPointerTo()
 	);
 	vargs[0] = vargs[1] = scope_type;
-	if (var) vargs[2] = builder.getInt16Ty();
+	if (var) {
+		vargs[2] = builder.getInt16Ty();
+		if (sig.fixed) vargs.resize(3 + sig.arity, ret_type);
+	}
 
-	FunctionType *type = FunctionType::get(ret_type, vargs, false);
-	function = Function::Create(type, Function::ExternalLinkage, name, &module);
+	Type *result = sig.real ? real_type : ret_type;
+	FunctionType *type = FunctionType::get(result, vargs, false);
+	function = Function::Create(type, Function::ExternalLinkage, name, module.get());
 
 	Function::arg_iterator ai = function->arg_begin();
 	ai->setName("self");
 	ai++; ai->setName("other");
 	if (var) {
 		ai++; ai->setName("argc");
-		ai++; ai->setName("argv");
+		if (!sig.fixed) {
+			ai++; ai->setName("argv");
+		}
+		for (unsigned i = 0; i < sig.arity; i++) {
+			ai++; ai->setName("argument" + Twine(i));
+		}
 	}
 
 	return function;
@@ -779,7 +1528,7 @@ Value *node_codegen::get_real(double val) {
 	};
 	Constant *variant = ConstantStruct::getAnon(contents);
 	GlobalVariable *global = new GlobalVariable(
-		module, variant->getType(), true, GlobalValue::InternalLinkage, variant
+		*module, variant->getType(), true, GlobalValue::InternalLinkage, variant
 	);
 	global->setUnnamedAddr(true);
 
@@ -788,22 +1537,25 @@ Value *node_codegen::get_real(double val) {
 
 Value *node_codegen::get_real(Value *val) {
 	Value *variant = alloc(variant_type, "real");
+	builder.CreateStore(builder.getInt8(0), type_ptr(variant));
+	builder.CreateStore(val, real_ptr(variant));
+	return variant;
+}
 
-	Value *tindices[] = { builder.getInt32(0), builder.getInt32(0) };
-	Value *type = builder.CreateInBoundsGEP(variant, tindices);
-	builder.CreateStore(builder.getInt8(0), type);
+Value *node_codegen::type_ptr(Value *variant) {
+	Value *indices[] = { builder.getInt32(0), builder.getInt32(0) };
+	return builder.CreateInBoundsGEP(variant, indices);
+}
 
-	Value *rindices[] = { builder.getInt32(0), builder.getInt32(1) };
-	Value *real = builder.CreateBitCast(
-		builder.CreateInBoundsGEP(variant, rindices),
+Value *node_codegen::real_ptr(Value *variant) {
+	Value *indices[] = { builder.getInt32(0), builder.getInt32(1) };
+	return builder.CreateBitCast(
+		builder.CreateInBoundsGEP(variant, indices),
 		builder.getDoubleTy()->getPointerTo()
 	);
-	builder.CreateStore(val, real);
-
-	return variant;
 }
 
-Value *node_codegen::get_string(StringRef val) {
+Value *node_codegen::get_literal(StringRef val) {
 	GlobalVariable *literal;
 	if (string_literals.find(val) != string_literals.end()) {
 		literal = string_literals[val];
@@ -818,15 +1570,24 @@ Value *node_codegen::get_string(StringRef val) {
 				size_type, string::compute_hash(val.size(), val.data()), false
 			),
 			ConstantInt::get(size_type, val.size()), // length
-			ConstantDataArray::getString(module.getContext(), val, false) // data
+			ConstantInt::get(size_type, 0), // capacity
+			ConstantDataArray::getString(module->getContext(), val, false) // data
 		};
 		Constant *s = ConstantStruct::getAnon(contents);
+		GlobalVariable *data = new GlobalVariable(
+			*module, s->getType(), false, GlobalValue::PrivateLinkage, s
+		);
 		literal = new GlobalVariable(
-			module, s->getType(), false, GlobalValue::PrivateLinkage, s
+			*module, string_type, false, GlobalValue::InternalLinkage,
+			ConstantExpr::getBitCast(data, string_type), "literal"
 		);
 		string_literals[val] = literal;
 	}
 
+	return builder.CreateLoad(literal);
+}
+
+Value *node_codegen::get_string(StringRef val) {
 	Value *variant = alloc(variant_type, "string");
 
 	Value *tindices[] = { builder.getInt32(0), builder.getInt32(0) };
@@ -838,27 +1599,129 @@ Value *node_codegen::get_string(StringRef val) {
 		builder.CreateInBoundsGEP(variant, sindices),
 		string_type->getPointerTo()
 	);
-	builder.CreateStore(builder.CreateCall(
-		intern, builder.CreateBitCast(literal, string_type)
-	), string);
+	builder.CreateStore(get_literal(val), string);
 
 	return variant;
 }
 
-Value *node_codegen::to_bool(node *cond) {
-	Value *expr = builder.CreateCall(to_real, visit(cond));
+Value *node_codegen::visit_real(expression *e) {
+	switch (e->type) {
+	default: return 0;
+
+	case value_node: {
+		token &t = static_cast<value*>(e)->t;
+		if (t.type == v_name)
+			return builder.CreateLoad(reals[std::string(t.string.data, t.string.length)]);
+
+		return ConstantFP::get(real_type, constant_real(t));
+	}
+
+	case unary_node: {
+		unary *u = static_cast<unary*>(e);
+		return real_unary(u->op, visit_real(u->right));
+	}
+
+	case binary_node: {
+		binary *b = static_cast<binary*>(e);
+		return real_binary(b->op, visit_real(b->left), visit_real(b->right));
+	}
+
+	case call_node: return emit_call(static_cast<call*>(e));
+	}
+}
+
+Value *node_codegen::real_unary(token_type op, Value *right) {
+	switch (op) {
+	default: return 0;
+
+	case exclaim:
+		return builder.CreateUIToFP(
+			builder.CreateFCmpOEQ(right, ConstantFP::get(real_type, 0)), real_type
+		);
+	case tilde:
+		return builder.CreateSIToFP(builder.CreateNot(
+			builder.CreateFPToSI(right, builder.getInt32Ty())
+		), real_type);
+	case minus: return builder.CreateFNeg(right);
+	case plus: return right;
+	}
+}
+
+// these all follow the real_real cases in runtime/variant.cc
+Value *node_codegen::real_binary(token_type op, Value *left, Value *right) {
+	Value *zero = ConstantFP::get(real_type, 0);
+	Type *int_type = builder.getInt32Ty();
+	Value *result;
+	switch (op) {
+	default: return 0;
+
+	case less: result = builder.CreateFCmpOLT(left, right); break;
+	case less_equals: result = builder.CreateFCmpOLE(left, right); break;
+	case is_equals: result = builder.CreateFCmpOEQ(left, right); break;
+	case not_equals: result = builder.CreateFCmpUNE(left, right); break;
+	case greater_equals: result = builder.CreateFCmpOGE(left, right); break;
+	case greater: result = builder.CreateFCmpOGT(left, right); break;
+
+	case plus: return builder.CreateFAdd(left, right);
+	case minus: return builder.CreateFSub(left, right);
+	case times: return builder.CreateFMul(left, right);
+	case divide: return builder.CreateFDiv(left, right);
+
+	case ampamp: case pipepipe: case caretcaret: {
+		Value *l = builder.CreateFCmpUNE(left, zero);
+		Value *r = builder.CreateFCmpUNE(right, zero);
+		if (op == ampamp) result = builder.CreateAnd(l, r);
+		else if (op == pipepipe) result = builder.CreateOr(l, r);
+		else result = builder.CreateXor(l, r);
+		break;
+	}
+
+	case bit_and: case bit_or: case bit_xor:
+	case shift_left: case shift_right: {
+		Value *l = builder.CreateFPToSI(left, int_type);
+		Value *r = builder.CreateFPToSI(right, int_type);
+		Value *i;
+		switch (op) {
+		default: /* unreachable */
+		case bit_and: i = builder.CreateAnd(l, r); break;
+		case bit_or: i = builder.CreateOr(l, r); break;
+		case bit_xor: i = builder.CreateXor(l, r); break;
+		case shift_left: i = builder.CreateShl(l, r); break;
+		case shift_right: i = builder.CreateAShr(l, r); break;
+		}
+		return builder.CreateSIToFP(i, real_type);
+	}
+
+	case kw_div:
+		return builder.CreateSIToFP(builder.CreateFPToSI(
+			builder.CreateFDiv(left, right), int_type
+		), real_type);
+	case kw_mod: return builder.CreateFRem(left, right);
+	}
+
+	return builder.CreateUIToFP(result, real_type);
+}
+
+Value *node_codegen::as_real(expression *e) {
+	if (types.is_real(e)) return visit_real(e);
+	return builder.CreateCall(to_real, visit(e));
+}
+
+Value *node_codegen::to_bool(expression *cond) {
+	Value *expr = as_real(cond);
 	return builder.CreateFCmpUGT(expr, ConstantFP::get(builder.getDoubleTy(), 0.5));
 }
 
 Value *node_codegen::is_equal(Value *a, Value *b) {
 	Value *res = alloc(variant_type);
-	builder.CreateCall3(get_operator("is_equals", 2), res, a, b);
+	Value *ret = builder.CreateCall2(get_operator("is_equals", 2), a, b);
+	builder.CreateStore(ret, builder.CreateBitCast(res, ret_type->getPointerTo()));
 	Value *expr = builder.CreateCall(to_real, res);
 	return builder.CreateFCmpUGT(expr, ConstantFP::get(builder.getDoubleTy(), 0.5));
 }
 
 Value *node_codegen::make_local(StringRef name, Value *value) {
-	return make_local(name, builder.getInt16(0), builder.getInt16(0), value);
+	return make_local(name, builder.getInt32(0), builder.getInt32(0), value);
 }
 
 Value *node_codegen::make_local(
@@ -874,19 +1737,89 @@ Value *node_codegen::make_local(
 	Value *yptr = builder.CreateInBoundsGEP(l, yindices);
 	builder.CreateStore(y, yptr);
 
-	Value *vindices[] = { builder.getInt32(0), builder.getInt32(2) };
+	// a stride of 0 marks the contents as borrowed
+	Value *sindices[] = { builder.getInt32(0), builder.getInt32(2) };
+	Value *sptr = builder.CreateInBoundsGEP(l, sindices);
+	builder.CreateStore(builder.getInt32(0), sptr);
+
+	Value *rindices[] = { builder.getInt32(0), builder.getInt32(3) };
+	Value *rptr = builder.CreateInBoundsGEP(l, rindices);
+	builder.CreateStore(y, rptr);
+
+	Value *vindices[] = { builder.getInt32(0), builder.getInt32(4) };
 	Value *vptr = builder.CreateInBoundsGEP(l, vindices);
 	builder.CreateStore(values, vptr);
 
-	builder.CreateCall(retain_var, l);
-
+	// locals are either declared empty or borrow the caller's arguments for
+	// the length of the call, so neither needs retaining. access_var copies a
+	// borrowed array before anything is stored through it
 	return l;
 }
 
+// slot numbers are only known once the whole game is linked, so each name is
+// an external constant for the linker to fill in
+Value *node_codegen::get_slot(StringRef name) {
+	std::string slot = "slot." + name.str();
+	GlobalVariable *global = module->getNamedGlobal(slot);
+	if (!global) {
+		global = new GlobalVariable(
+			*module, builder.getInt32Ty(), true,
+			GlobalValue::ExternalLinkage, nullptr, slot
+		);
+	}
+
+	return builder.CreateLoad(global);
+}
+
+// each site gets an inline cache of the last scope it resolved, so repeated
+// obj.field accesses from the same instances skip the runtime entirely
 Value *node_codegen::do_lookup(Value *left, Value *right, bool lvalue) {
-	return builder.CreateCall5(
-		lookup, self_scope, other_scope, left, right, builder.getInt1(lvalue)
+	GlobalVariable *cache = new GlobalVariable(
+		*module, cache_type, false, GlobalValue::InternalLinkage,
+		Constant::getNullValue(cache_type), "lookup_cache"
 	);
+
+	auto field = [&](int i) {
+		Value *indices[] = { builder.getInt32(0), builder.getInt32(i) };
+		return builder.CreateLoad(builder.CreateInBoundsGEP(cache, indices));
+	};
+	Value *hit = builder.CreateAnd(
+		builder.CreateAnd(
+			builder.CreateFCmpOEQ(field(0), left),
+			builder.CreateICmpEQ(field(1), self_scope)
+		),
+		builder.CreateAnd(
+			builder.CreateICmpEQ(field(2), other_scope),
+			builder.CreateICmpEQ(field(3), builder.CreateLoad(scope_epoch))
+		)
+	);
+
+	Function *f = builder.GetInsertBlock()->getParent();
+	BasicBlock *fast = BasicBlock::Create(f->getContext(), "cached");
+	BasicBlock *slow = BasicBlock::Create(f->getContext(), "lookup");
+	BasicBlock *merge = BasicBlock::Create(f->getContext(), "merge");
+	branch(hit, fast, slow);
+
+	f->getBasicBlockList().push_back(fast);
+	builder.SetInsertPoint(fast);
+	Value *cached = field(4);
+	builder.CreateBr(merge);
+
+	f->getBasicBlockList().push_back(slow);
+	builder.SetInsertPoint(slow);
+	Value *args[] = {
+		cache, self_scope, other_scope, left, right, builder.getInt1(lvalue)
+	};
+	Value *found = builder.CreateCall(lookup, args);
+	builder.CreateBr(merge);
+
+	f->getBasicBlockList().push_back(merge);
+	builder.SetInsertPoint(merge);
+	PHINode *var = builder.CreatePHI(cached->getType(), 2);
+	var->addIncoming(cached, fast);
+	var->addIncoming(found, slow);
+
+	return var;
 }
 
 Value *node_codegen::do_lookup_default(Value *right, bool lvalue) {
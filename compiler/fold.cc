@@ -0,0 +1,309 @@
+#include <dejavu/compiler/fold.h>
+#include <dejavu/compiler/types.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// the same values codegen gives these in constant_real
+static bool as_constant(expression *e, double &real) {
+	if (e->type != value_node) return false;
+
+	token &t = static_cast<value*>(e)->t;
+	switch (t.type) {
+	case v_real: real = t.real; return true;
+	case kw_true: real = 1; return true;
+	case kw_false: real = 0; return true;
+	default: return false;
+	}
+}
+
+static bool as_string(expression *e, token &t) {
+	if (e->type != value_node) return false;
+
+	t = static_cast<value*>(e)->t;
+	return t.type == v_string;
+}
+
+// codegen converts with fptosi, which has no defined result out of range
+static bool as_int(double real, int32_t &i) {
+	if (!(real > INT32_MIN - 1.0 && real < INT32_MAX + 1.0)) return false;
+
+	i = (int32_t)real;
+	return true;
+}
+
+// to_bool, the way branches see a condition
+static bool is_true(double real) {
+	return !(real <= 0.5);
+}
+
+// these all follow real_unary and real_binary in codegen. anything that isn't
+// well-defined there is left for runtime
+static bool fold_unary(token_type op, double right, double &result) {
+	int32_t i;
+	switch (op) {
+	case exclaim: result = right == 0; return true;
+	case tilde:
+		if (!as_int(right, i)) return false;
+		result = ~i;
+		return true;
+	case minus: result = -right; return true;
+	case plus: result = right; return true;
+	default: return false;
+	}
+}
+
+static bool fold_binary(token_type op, double left, double right, double &result) {
+	int32_t l, r;
+	switch (op) {
+	case less: result = left < right; return true;
+	case less_equals: result = left <= right; return true;
+	case is_equals: result = left == right; return true;
+	case not_equals: result = left != right; return true;
+	case greater_equals: result = left >= right; return true;
+	case greater: result = left > right; return true;
+
+	case plus: result = left + right; return true;
+	case minus: result = left - right; return true;
+	case times: result = left * right; return true;
+	case divide:
+		if (right == 0) return false;
+		result = left / right;
+		return true;
+
+	case ampamp: result = (left != 0) && (right != 0); return true;
+	case pipepipe: result = (left != 0) || (right != 0); return true;
+	case caretcaret: result = (left != 0) != (right != 0); return true;
+
+	case bit_and: case bit_or: case bit_xor:
+	case shift_left: case shift_right:
+		if (!as_int(left, l) || !as_int(right, r)) return false;
+		switch (op) {
+		case bit_and: result = l & r; return true;
+		case bit_or: result = l | r; return true;
+		case bit_xor: result = l ^ r; return true;
+		default:
+			if (r < 0 || r >= 32) return false;
+			if (op == shift_left) result = (int32_t)((uint32_t)l << r);
+			else result = l >> r;
+			return true;
+		}
+
+	case kw_div:
+		if (right == 0 || !as_int(left / right, l)) return false;
+		result = l;
+		return true;
+	case kw_mod:
+		if (right == 0) return false;
+		result = fmod(left, right);
+		return true;
+
+	default: return false;
+	}
+}
+
+// whether a branch that never runs still matters. declarations take effect
+// for the whole function wherever they are, and cases belong to the switch
+// around them, so a branch with either can't go. calls and assignments in it
+// never run, so they don't count
+class affects_outside : public node_visitor<affects_outside, bool> {
+public:
+	bool check(node *n) { return n && visit(n); }
+
+	bool visit_declaration(declaration*) { return true; }
+	bool visit_casestatement(casestatement*) { return true; }
+
+	bool visit_block(block *b) {
+		for (statement *stmt : b->stmts) {
+			if (check(stmt)) return true;
+		}
+		return false;
+	}
+
+	bool visit_ifstatement(ifstatement *i) {
+		return check(i->branch_true) || check(i->branch_false);
+	}
+	bool visit_whilestatement(whilestatement *w) { return check(w->stmt); }
+	bool visit_dostatement(dostatement *d) { return check(d->stmt); }
+	bool visit_repeatstatement(repeatstatement *r) { return check(r->stmt); }
+	bool visit_forstatement(forstatement *f) {
+		return check(f->init) || check(f->inc) || check(f->stmt);
+	}
+	bool visit_switchstatement(switchstatement *s) { return check(s->stmts); }
+	bool visit_withstatement(withstatement *w) { return check(w->stmt); }
+};
+
+static bool can_drop(statement *stmt) {
+	return !affects_outside().check(stmt);
+}
+
+node *node_folder::fold(node *n) {
+	if (!n) return n;
+
+	node *replacement = visit(n);
+	return replacement ? replacement : n;
+}
+
+value *node_folder::make_real(const token &position, double real) {
+	token t(v_real, position.row, position.col);
+	t.real = real;
+	return new (allocator) value(t);
+}
+
+statement *node_folder::make_empty() {
+	return new (allocator) block(node_list<statement>());
+}
+
+node *node_folder::visit_unary(unary *u) {
+	u->right = fold_child(u->right);
+
+	double right, result;
+	if (!as_constant(u->right, right)) return 0;
+	if (!fold_unary(u->op, right, result)) return 0;
+
+	return make_real(static_cast<value*>(u->right)->t, result);
+}
+
+node *node_folder::visit_binary(binary *b) {
+	b->left = fold_child(b->left);
+	if (b->op == dot) return 0;
+	b->right = fold_child(b->right);
+
+	double left, right, result;
+	if (as_constant(b->left, left) && as_constant(b->right, right)) {
+		if (!fold_binary(b->op, left, right, result)) return 0;
+		return make_real(static_cast<value*>(b->left)->t, result);
+	}
+
+	// the runtime compares strings by content, so equality is just the bytes
+	token l, r;
+	if (!as_string(b->left, l) || !as_string(b->right, r)) return 0;
+	switch (b->op) {
+	case plus: {
+		size_t length = l.string.length + r.string.length;
+		char *data = static_cast<char*>(allocator.allocate(length, 1));
+		memcpy(data, l.string.data, l.string.length);
+		memcpy(data + l.string.length, r.string.data, r.string.length);
+
+		token t(v_string, l.row, l.col);
+		t.string.data = data;
+		t.string.length = length;
+		return new (allocator) value(t);
+	}
+
+	case is_equals: case not_equals: {
+		bool equal =
+			l.string.length == r.string.length &&
+			memcmp(l.string.data, r.string.data, l.string.length) == 0;
+		return make_real(l, equal == (b->op == is_equals));
+	}
+
+	default: return 0;
+	}
+}
+
+node *node_folder::visit_subscript(subscript *s) {
+	fold_children(s->indices);
+	return 0;
+}
+
+node *node_folder::visit_call(call *c) {
+	fold_children(c->args);
+	return 0;
+}
+
+node *node_folder::visit_assignment(assignment *a) {
+	a->lvalue = fold_child(a->lvalue);
+	a->rvalue = fold_child(a->rvalue);
+	return 0;
+}
+
+node *node_folder::visit_invocation(invocation *i) {
+	fold(i->c);
+	return 0;
+}
+
+node *node_folder::visit_block(block *b) {
+	fold_children(b->stmts);
+	return 0;
+}
+
+node *node_folder::visit_ifstatement(ifstatement *i) {
+	i->cond = fold_child(i->cond);
+	i->branch_true = fold_child(i->branch_true);
+	i->branch_false = fold_child(i->branch_false);
+
+	double cond;
+	if (!as_constant(i->cond, cond)) return 0;
+
+	statement *taken = is_true(cond) ? i->branch_true : i->branch_false;
+	statement *dropped = is_true(cond) ? i->branch_false : i->branch_true;
+	if (!can_drop(dropped)) return 0;
+
+	return taken ? taken : make_empty();
+}
+
+node *node_folder::visit_whilestatement(whilestatement *w) {
+	w->cond = fold_child(w->cond);
+	w->stmt = fold_child(w->stmt);
+
+	double cond;
+	if (!as_constant(w->cond, cond) || is_true(cond)) return 0;
+	if (!can_drop(w->stmt)) return 0;
+
+	return make_empty();
+}
+
+node *node_folder::visit_dostatement(dostatement *d) {
+	d->stmt = fold_child(d->stmt);
+	d->cond = fold_child(d->cond);
+	return 0;
+}
+
+// the body runs while the count is above how many times it already has
+node *node_folder::visit_repeatstatement(repeatstatement *r) {
+	r->expr = fold_child(r->expr);
+	r->stmt = fold_child(r->stmt);
+
+	double count;
+	if (!as_constant(r->expr, count) || !(count <= 0)) return 0;
+	if (!can_drop(r->stmt)) return 0;
+
+	return make_empty();
+}
+
+// the initializer still runs when the loop never does
+node *node_folder::visit_forstatement(forstatement *f) {
+	f->init = fold_child(f->init);
+	f->cond = fold_child(f->cond);
+	f->inc = fold_child(f->inc);
+	f->stmt = fold_child(f->stmt);
+
+	double cond;
+	if (!as_constant(f->cond, cond) || is_true(cond)) return 0;
+	if (!can_drop(f->inc) || !can_drop(f->stmt)) return 0;
+
+	return f->init ? f->init : make_empty();
+}
+
+node *node_folder::visit_switchstatement(switchstatement *s) {
+	s->expr = fold_child(s->expr);
+	fold(s->stmts);
+	return 0;
+}
+
+node *node_folder::visit_withstatement(withstatement *w) {
+	w->expr = fold_child(w->expr);
+	w->stmt = fold_child(w->stmt);
+	return 0;
+}
+
+node *node_folder::visit_returnstatement(returnstatement *r) {
+	r->expr = fold_child(r->expr);
+	return 0;
+}
+
+node *node_folder::visit_casestatement(casestatement *c) {
+	c->expr = fold_child(c->expr);
+	return 0;
+}
@@ -1,15 +1,16 @@
 #include <dejavu/compiler/lexer.h>
 #include <dejavu/system/buffer.h>
 #include <cstdlib>
-#include <map>
+#include <cstring>
 #include <sstream>
 #include <string>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace {
 
-bool isspace(char c) {
-	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
-}
 bool isnewline(char c) {
 	return c == '\n' || c == '\r';
 }
@@ -38,21 +39,165 @@ bool isdigit(char c) {
 	return '0' <= c && c <= '9';
 }
 
-struct keyword_table : public std::map<std::string, token_type> {
-	keyword_table();
-} keywords;
-
-keyword_table::keyword_table() {
-	keywords["begin"] = l_brace;
-	keywords["end"] = r_brace;
-	keywords["not"] = exclaim;
-	keywords["and"] = ampamp;
-	keywords["or"] = pipepipe;
-	keywords["xor"] = caretcaret;
-#	define KEYWORD(X) keywords[#X] = kw_ ## X;
-#	include "dejavu/compiler/tokens.tbl"
+// the scanners below work 16 bytes at a time where sse2 is available, as a
+// bitmask per byte class, and fall back to a byte at a time for the tail of
+// the buffer and everywhere else
+#ifdef __SSE2__
+const ptrdiff_t chunk = 16;
+
+__m128i load(const char *p) {
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+unsigned match(__m128i b, char c) {
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(b, _mm_set1_epi8(c)));
+}
+
+// signed compares, so anything past ascii is never in range
+unsigned match(__m128i b, char lo, char hi) {
+	return _mm_movemask_epi8(_mm_and_si128(
+		_mm_cmpgt_epi8(b, _mm_set1_epi8(lo - 1)),
+		_mm_cmplt_epi8(b, _mm_set1_epi8(hi + 1))
+	));
+}
+
+unsigned low_bits(unsigned n) { return (1u << n) - 1; }
+#endif
+
+// spaces and tabs, which are all that usually follows a newline
+const char *skip_blanks(const char *p, const char *end, size_t &col) {
+#ifdef __SSE2__
+	for (; end - p >= chunk; p += chunk) {
+		__m128i b = load(p);
+		unsigned tabs = match(b, '\t'), blanks = match(b, ' ') | tabs;
+		if (blanks != 0xffff) {
+			unsigned n = __builtin_ctz(~blanks);
+			col += n + 3 * __builtin_popcount(tabs & low_bits(n));
+			return p + n;
+		}
+		col += chunk + 3 * __builtin_popcount(tabs);
+	}
+#endif
+	for (; p != end; p++) {
+		if (*p == '\t') col += 4;
+		else if (*p == ' ') col += 1;
+		else break;
+	}
+	return p;
+}
+
+const char *skip_names(const char *p, const char *end) {
+#ifdef __SSE2__
+	for (; end - p >= chunk; p += chunk) {
+		__m128i b = load(p);
+		unsigned names =
+			match(b, 'a', 'z') | match(b, 'A', 'Z') | match(b, '0', '9') |
+			match(b, '_');
+		if (names != 0xffff) return p + __builtin_ctz(~names);
+	}
+#endif
+	while (p != end && isname(*p)) p++;
+	return p;
+}
+
+const char *find_newline(const char *p, const char *end) {
+#ifdef __SSE2__
+	for (; end - p >= chunk; p += chunk) {
+		__m128i b = load(p);
+		unsigned lines = match(b, '\n') | match(b, '\r');
+		if (lines) return p + __builtin_ctz(lines);
+	}
+#endif
+	while (p != end && !isnewline(*p)) p++;
+	return p;
+}
+
+// finds stop, counting the newlines on the way. col restarts at base after
+// each one. p[-1] has to be part of the buffer, since \r\n counts once
+const char *scan_lines(
+	const char *p, const char *end, char stop,
+	size_t &row, size_t &col, size_t base
+) {
+#ifdef __SSE2__
+	for (; end - p >= chunk; p += chunk) {
+		__m128i b = load(p);
+		unsigned stops = match(b, stop);
+		unsigned n = stops ? __builtin_ctz(stops) : chunk;
+
+		unsigned before = low_bits(n);
+		unsigned cr = match(b, '\r') & before, lf = match(b, '\n') & before;
+		unsigned pairs = lf & (cr << 1 | (p[-1] == '\r'));
+		if (cr | lf) {
+			row += __builtin_popcount(cr) + __builtin_popcount(lf & ~pairs);
+			col = base + n - (32 - __builtin_clz(cr | lf));
+		}
+		else {
+			col += n;
+		}
+
+		if (stops) return p + n;
+	}
+#endif
+	for (; p != end && *p != stop; p++) {
+		if (isnewline(*p)) {
+			if (!(*p == '\n' && p[-1] == '\r')) row += 1;
+			col = base;
+		}
+		else {
+			col += 1;
+		}
+	}
+	return p;
+}
+
+struct keyword {
+	const char *name = nullptr;
+	size_t length = 0;
+	token_type type = unexpected;
+};
+
+constexpr size_t length(const char *s) {
+	size_t n = 0;
+	while (s[n]) n++;
+	return n;
 }
 
+// perfect for exactly these keywords- the static_assert below catches any
+// addition that collides, and the constants can be re-searched if one does
+constexpr size_t min_keyword = 2, max_keyword = 9;
+constexpr unsigned keyword_hash(const char *s, size_t n) {
+	return (30 * s[0] + 22 * s[1] + 5 * s[n - 1] + n) & 63;
+}
+
+constexpr keyword keyword_list[] = {
+	{ "begin", length("begin"), l_brace },
+	{ "end", length("end"), r_brace },
+	{ "not", length("not"), exclaim },
+	{ "and", length("and"), ampamp },
+	{ "or", length("or"), pipepipe },
+	{ "xor", length("xor"), caretcaret },
+#	define KEYWORD(X) { #X, length(#X), kw_ ## X },
+#	include "dejavu/compiler/tokens.tbl"
+};
+
+struct keyword_table {
+	constexpr keyword_table() : slots(), collision(false) {
+		for (const keyword &k : keyword_list) {
+			if (k.length < min_keyword || k.length > max_keyword) collision = true;
+
+			keyword &slot = slots[keyword_hash(k.name, k.length)];
+			if (slot.name) collision = true;
+			slot = k;
+		}
+	}
+
+	keyword slots[64];
+	bool collision;
+};
+
+constexpr keyword_table keywords;
+static_assert(!keywords.collision, "keyword_hash is no longer perfect");
+
 }
 
 token_stream::token_stream(buffer &b) :
@@ -92,43 +237,25 @@ token token_stream::gettoken() {
 
 // skips any whitespace or comments at the current position
 void token_stream::skipwhitespace() {
-	for (; current != buffer_end; current++) {
-		if (*current == '\t') {
-			col += 4;
+	while (current != buffer_end) {
+		if (*current == ' ' || *current == '\t') {
+			current = skip_blanks(current, buffer_end, col);
 		}
 		else if (isnewline(*current)) {
 			skipnewline();
+			current++;
 		}
-		else if (isspace(*current)) {
-			col += 1;
-		}
-		else if (*current == '/') {
-			if (skipcomment()) {
-				if (current == buffer_end) {
-					break;
-				}
-			}
-			else {
-				break;
-			}
-		}
-		else {
+		else if (*current != '/' || !skipcomment()) {
 			break;
 		}
 	}
 }
 
+// leaves a single-line comment's newline to skipwhitespace
 bool token_stream::skipcomment() {
 	// single-line comment
 	if (*(current + 1) == '/') {
-		current += 2;
-
-		for (; current != buffer_end; current++) {
-			if (isnewline(*current)) {
-				break;
-			}
-		}
-
+		current = find_newline(current + 2, buffer_end);
 		return true;
 	}
 	// multi-line comment
@@ -136,18 +263,18 @@ bool token_stream::skipcomment() {
 		current += 2;
 		col += 2;
 
-		for (; current != buffer_end; current++) {
-			if (*current == '*' && *(current + 1) == '/') {
-				current++;
+		while (current != buffer_end) {
+			current = scan_lines(current, buffer_end, '*', row, col, 1);
+			if (current == buffer_end) break;
+
+			if (*(current + 1) == '/') {
+				current += 2;
 				col += 2;
 				break;
 			}
-			else if (isnewline(*current)) {
-				skipnewline();
-			}
-			else {
-				col += 1;
-			}
+
+			current++;
+			col += 1;
 		}
 
 		return true;
@@ -174,17 +301,17 @@ token token_stream::getname() {
 	token t(v_name, row, col);
 	t.string.data = current;
 
-	do {
-		current++;
-	} while (isname(*current));
+	current = skip_names(current + 1, buffer_end);
 	t.string.length = current - t.string.data;
 
 	col += t.string.length;
 
-	// todo: figure out a better way than constructing an std::string?
-	std::string key = std::string(t.string.data, t.string.length);
-	if (keywords.count(key))
-		t.type = keywords[key];
+	size_t n = t.string.length;
+	if (min_keyword <= n && n <= max_keyword) {
+		const keyword &k = keywords.slots[keyword_hash(t.string.data, n)];
+		if (k.length == n && memcmp(k.name, t.string.data, n) == 0)
+			t.type = k.type;
+	}
 
 	return t;
 }
@@ -310,14 +437,9 @@ token token_stream::getstring() {
 	char delim = *current++;
 	col += 1;
 
+	// a column past the newline, as if it were part of the line before
 	t.string.data = current;
-	while (current != buffer_end && *current != delim) {
-		if (isnewline(*current))
-			skipnewline();
-
-		current++;
-		col += 1;
-	}
+	current = scan_lines(current, buffer_end, delim, row, col, 2);
 	t.string.length = current - t.string.data;
 
 	current++;
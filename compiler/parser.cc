@@ -13,8 +13,6 @@ bool isassignment(token_type t) {
 	}
 }
 
-symbol_table symbols;
-
 parser::parser(token_stream& l, arena &allocator, error_stream& e) :
 	lexer(l), current(lexer.gettoken()), allocator(allocator), errors(e) {}
 
@@ -24,18 +22,29 @@ node *parser::getprogram() {
 		stmt = getstatement();
 	}
 	else {
-		std::vector<statement*> stmts;
+		size_t start = children.size();
 		while (current.type != eof) {
-			stmts.push_back(getstatement());
+			children.push_back(getstatement());
 		}
 
-		stmt = new (allocator) block(stmts);
+		stmt = new (allocator) block(take_children<statement>(start));
 	}
 
 	advance(eof);
 	return stmt;
 }
 
+statement *parser::getnext() {
+	if (current.type == eof) return 0;
+	return getstatement();
+}
+
+expression *parser::getfragment() {
+	expression *expr = getexpression();
+	advance(eof);
+	return expr;
+}
+
 expression *parser::getexpression(int prec) {
 	token t = advance();
 
@@ -109,9 +118,9 @@ expression *parser::dot_led(token t, expression *left) {
 }
 
 expression *parser::square_led(token, expression *left) {
-	std::vector<expression*> indices;
+	size_t start = children.size();
 	while (current.type != r_square && current.type != eof) {
-		indices.push_back(getexpression());
+		children.push_back(getexpression());
 
 		if (current.type == comma) {
 			advance();
@@ -123,6 +132,7 @@ expression *parser::square_led(token, expression *left) {
 
 	//advance(r_square); // or expected comma
 	if (current.type != r_square) {
+		children.resize(start);
 		token e = current;
 		while (!symbols[current.type].std) advance();
 
@@ -131,13 +141,13 @@ expression *parser::square_led(token, expression *left) {
 
 	advance();
 
-	return new (allocator) subscript(left, indices);
+	return new (allocator) subscript(left, take_children<expression>(start));
 }
 
 expression *parser::paren_led(token, expression *left) {
-	std::vector<expression*> args;
+	size_t start = children.size();
 	while (current.type != r_paren && current.type != eof) {
-		args.push_back(getexpression(0));
+		children.push_back(getexpression(0));
 
 		if (current.type == comma) {
 			advance();
@@ -149,7 +159,9 @@ expression *parser::paren_led(token, expression *left) {
 
 	advance(r_paren); // or expected comma
 
-	return new (allocator) call(static_cast<value*>(left), args);
+	return new (allocator) call(
+		static_cast<value*>(left), take_children<expression>(start)
+	);
 }
 
 statement *parser::getstatement() {
@@ -193,12 +205,13 @@ statement *parser::expr_std() {
 statement *parser::var_std() {
 	token t = advance();
 
-	std::vector<value*> names;
+	size_t start = children.size();
 	while (current.type != semicolon && current.type != eof) {
 		token n = advance(v_name);
-		if (n.type != v_name) return new (allocator) declaration(t, names);
+		if (n.type != v_name)
+			return new (allocator) declaration(t, take_children<value>(start));
 
-		names.push_back((value*)(this->*symbols[n.type].nud)(n));
+		children.push_back((this->*symbols[n.type].nud)(n));
 
 		if (current.type == comma) {
 			advance();
@@ -207,20 +220,20 @@ statement *parser::var_std() {
 
 	advance(semicolon);
 
-	return new (allocator) declaration(t, names);
+	return new (allocator) declaration(t, take_children<value>(start));
 }
 
 statement *parser::brace_std() {
 	advance();
 
-	std::vector<statement*> stmts;
+	size_t start = children.size();
 	while (current.type != r_brace && current.type != eof) {
-		stmts.push_back(getstatement());
+		children.push_back(getstatement());
 	}
 
 	advance(r_brace);
 
-	return new (allocator) block(stmts);
+	return new (allocator) block(take_children<statement>(start));
 }
 
 statement *parser::if_std() {
@@ -367,22 +380,22 @@ expression_error *parser::error_expr(const unexpected_token_error &e) {
 	return new (allocator) expression_error;
 }
 
-void symbol_table::prefix(token_type t, nud_parser nud) {
-	(*this)[t].nud = nud;
+constexpr void symbol_table::prefix(token_type t, nud_parser nud) {
+	table[t].nud = nud;
 }
 
-void symbol_table::infix(token_type t, int prec, led_parser led) {
-	(*this)[t].precedence = prec;
-	(*this)[t].led = led;
+constexpr void symbol_table::infix(token_type t, int prec, led_parser led) {
+	table[t].precedence = prec;
+	table[t].led = led;
 }
 
-symbol_table::symbol_table() {
-	symbols[v_real].nud = symbols[v_string].nud =
-	symbols[kw_self].nud = symbols[kw_other].nud =
-	symbols[kw_all].nud = symbols[kw_noone].nud =
-	symbols[kw_global].nud = symbols[kw_local].nud =
-	symbols[kw_true].nud = symbols[kw_false].nud =
-	symbols[v_name].nud = &parser::id_nud;
+constexpr symbol_table::symbol_table() : table() {
+	table[v_real].nud = table[v_string].nud =
+	table[kw_self].nud = table[kw_other].nud =
+	table[kw_all].nud = table[kw_noone].nud =
+	table[kw_global].nud = table[kw_local].nud =
+	table[kw_true].nud = table[kw_false].nud =
+	table[v_name].nud = &parser::id_nud;
 
 	infix(dot, 90, &parser::dot_led);
 
@@ -423,31 +436,33 @@ symbol_table::symbol_table() {
 	infix(pipepipe, 10);
 	infix(caretcaret, 10);
 
-	symbols[kw_var].std = symbols[kw_globalvar].std =
+	table[kw_var].std = table[kw_globalvar].std =
 	&parser::var_std;
 
-	symbols[v_name].std = symbols[l_paren].std =
-	symbols[kw_self].std = symbols[kw_other].std =
-	symbols[kw_all].std = symbols[kw_noone].std =
-	symbols[kw_global].std = symbols[kw_local].std =
+	table[v_name].std = table[l_paren].std =
+	table[kw_self].std = table[kw_other].std =
+	table[kw_all].std = table[kw_noone].std =
+	table[kw_global].std = table[kw_local].std =
 	&parser::expr_std;
 
-	symbols[l_brace].std = &parser::brace_std;
+	table[l_brace].std = &parser::brace_std;
 
-	symbols[kw_if].std = &parser::if_std;
-	symbols[kw_while].std = &parser::while_std;
-	symbols[kw_do].std = &parser::do_std;
-	symbols[kw_repeat].std = &parser::repeat_std;
-	symbols[kw_for].std = &parser::for_std;
-	symbols[kw_switch].std = &parser::switch_std;
-	symbols[kw_with].std = &parser::with_std;
+	table[kw_if].std = &parser::if_std;
+	table[kw_while].std = &parser::while_std;
+	table[kw_do].std = &parser::do_std;
+	table[kw_repeat].std = &parser::repeat_std;
+	table[kw_for].std = &parser::for_std;
+	table[kw_switch].std = &parser::switch_std;
+	table[kw_with].std = &parser::with_std;
 
-	symbols[kw_break].std = symbols[kw_continue].std =
-	symbols[kw_exit].std = &parser::jump_std;
-	symbols[kw_return].std = &parser::return_std;
-	symbols[kw_case].std = symbols[kw_default].std =
+	table[kw_break].std = table[kw_continue].std =
+	table[kw_exit].std = &parser::jump_std;
+	table[kw_return].std = &parser::return_std;
+	table[kw_case].std = table[kw_default].std =
 	&parser::case_std;
 
-	symbols[eof].std = &parser::null_std;
-	symbols[eof].nud = &parser::null_nud;
+	table[eof].std = &parser::null_std;
+	table[eof].nud = &parser::null_nud;
 }
+
+constexpr symbol_table symbols;
@@ -113,13 +113,10 @@ void node_printer::visit_declaration(declaration *d) {
 
 void node_printer::visit_block(block *b) {
 	printf("{\n"); scope++;
-	for (
-		std::vector<statement*>::iterator it = b->stmts.begin();
-		it != b->stmts.end(); ++it
-	) {
-		if ((*it)->type == casestatement_node) scope--;
-		indent(); visit(*it); printf("\n");
-		if ((*it)->type == casestatement_node) scope++;
+	for (statement *stmt : b->stmts) {
+		if (stmt->type == casestatement_node) scope--;
+		indent(); visit(stmt); printf("\n");
+		if (stmt->type == casestatement_node) scope++;
 	};
 	scope--; indent(); printf("}");
 }
@@ -0,0 +1,19 @@
+#include <dejavu/compiler/profile.h>
+#include <fstream>
+
+bool read_profile(const char *path, profile_data &profile) {
+	std::ifstream in(path);
+	if (!in) return false;
+
+	std::string name;
+	size_t count;
+	while (in >> name >> count) {
+		std::vector<uint64_t> &counters = profile[name];
+		counters.resize(count);
+		for (uint64_t &n : counters) {
+			if (!(in >> n)) return false;
+		}
+	}
+
+	return in.eof();
+}
@@ -0,0 +1,262 @@
+#include <dejavu/compiler/types.h>
+#include <algorithm>
+
+bool is_real_op(token_type op) {
+	switch (op) {
+	case less: case less_equals: case is_equals: case not_equals:
+	case greater_equals: case greater:
+	case plus: case minus: case times: case divide:
+	case ampamp: case pipepipe: case caretcaret:
+	case bit_and: case bit_or: case bit_xor: case shift_left: case shift_right:
+	case kw_div: case kw_mod:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+token_type compound_op(token_type op) {
+	switch (op) {
+	case plus_equals: return plus;
+	case minus_equals: return minus;
+	case times_equals: return times;
+	case div_equals: return divide;
+	case and_equals: return bit_and;
+	case or_equals: return bit_or;
+	case xor_equals: return bit_xor;
+	default: return unexpected;
+	}
+}
+
+// locals start out as reals and lose that as soon as anything stored to them
+// might not be one, until nothing changes. without a body they all stay boxed
+void node_types::analyze(node *body, bool var) {
+	declared.clear();
+	boxed.clear();
+	reals.clear();
+	stores.clear();
+	returns.clear();
+	fixed = true;
+	arity = 0;
+
+	if (var) reals.insert("argument_count");
+	if (!body) return;
+	visit(body);
+
+	for (const std::string &name : declared) {
+		if (boxed.find(name) == boxed.end()) reals.insert(name);
+	}
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (const store &s : stores) {
+			if (!is_real(s.name) || s.name == "argument_count") continue;
+
+			bool real = is_real(s.rvalue);
+			if (s.op != equals) real = real && compound_op(s.op) != unexpected;
+			if (real) continue;
+
+			reals.erase(s.name);
+			changed = true;
+		}
+	}
+}
+
+bool node_types::is_real(expression *e) {
+	switch (e->type) {
+	case value_node: {
+		token &t = static_cast<value*>(e)->t;
+		switch (t.type) {
+		case v_real:
+		case kw_self: case kw_other: case kw_all:
+		case kw_noone: case kw_global: case kw_local:
+		case kw_true: case kw_false:
+			return true;
+
+		case v_name:
+			return is_real(std::string(t.string.data, t.string.length));
+
+		default:
+			return false;
+		}
+	}
+
+	case unary_node: {
+		unary *u = static_cast<unary*>(e);
+		switch (u->op) {
+		case exclaim: case tilde: case minus: case plus:
+			return is_real(u->right);
+
+		default:
+			return false;
+		}
+	}
+
+	case binary_node: {
+		binary *b = static_cast<binary*>(e);
+		return is_real_op(b->op) && is_real(b->left) && is_real(b->right);
+	}
+
+	case call_node: {
+		if (!scripts) return false;
+
+		token &t = static_cast<call*>(e)->function->t;
+		auto it = scripts->find(std::string(t.string.data, t.string.length));
+		return it != scripts->end() && it->second.real;
+	}
+
+	default:
+		return false;
+	}
+}
+
+bool node_types::is_real(const std::string &name) {
+	return reals.find(name) != reals.end();
+}
+
+// running off the end returns 0, so a script with no return is still real
+script_signature node_types::signature() {
+	script_signature s;
+	s.real = std::all_of(returns.begin(), returns.end(), [this](expression *e) {
+		return is_real(e);
+	});
+	s.fixed = fixed;
+	if (fixed) s.arity = arity;
+	return s;
+}
+
+// the rest of this just collects declarations, stores and names that have to
+// stay boxed, in the same order codegen visits them
+
+void node_types::visit_value(value *v) {
+	if (v->t.type != v_name) return;
+
+	std::string name(v->t.string.data, v->t.string.length);
+	if (declared.find(name) == declared.end()) boxed.insert(name);
+
+	// on its own, argument is argument[0]
+	if (name == "argument") arity = std::max(arity, 1u);
+}
+
+void node_types::visit_unary(unary *u) {
+	visit(u->right);
+}
+
+void node_types::visit_binary(binary *b) {
+	visit(b->left);
+	if (b->op != dot) visit(b->right);
+}
+
+void node_types::visit_subscript(subscript *s) {
+	if (s->array->type == value_node) {
+		value *v = static_cast<value*>(s->array);
+		std::string name(v->t.string.data, v->t.string.length);
+		boxed.insert(name);
+
+		if (name == "argument") visit_argument(s);
+	}
+	else {
+		visit(s->array);
+	}
+
+	for (expression *index : s->indices) visit(index);
+}
+
+// codegen truncates indices, so a constant one names a single argument
+void node_types::visit_argument(subscript *s) {
+	expression *index = s->indices.size() == 1 ? s->indices[0] : 0;
+	if (!index || index->type != value_node) {
+		fixed = false;
+		return;
+	}
+
+	token &t = static_cast<value*>(index)->t;
+	if (t.type != v_real || !(t.real >= 0 && t.real < max_arity)) {
+		fixed = false;
+		return;
+	}
+
+	arity = std::max(arity, (unsigned)t.real + 1);
+}
+
+void node_types::visit_call(call *c) {
+	for (expression *arg : c->args) visit(arg);
+}
+
+void node_types::visit_assignment(assignment *a) {
+	visit(a->rvalue);
+	visit(a->lvalue);
+
+	if (a->lvalue->type != value_node) return;
+	token &t = static_cast<value*>(a->lvalue)->t;
+	if (t.type != v_name) return;
+
+	stores.push_back(store{
+		std::string(t.string.data, t.string.length), a->op, a->rvalue
+	});
+}
+
+void node_types::visit_invocation(invocation *i) {
+	visit(i->c);
+}
+
+void node_types::visit_declaration(declaration *d) {
+	if (d->type.type != kw_var) return;
+
+	for (value *v : d->names) {
+		declared.insert(std::string(v->t.string.data, v->t.string.length));
+	}
+}
+
+void node_types::visit_block(block *b) {
+	for (statement *stmt : b->stmts) visit(stmt);
+}
+
+void node_types::visit_ifstatement(ifstatement *i) {
+	visit(i->cond);
+	visit(i->branch_true);
+	if (i->branch_false) visit(i->branch_false);
+}
+
+void node_types::visit_whilestatement(whilestatement *w) {
+	visit(w->cond);
+	visit(w->stmt);
+}
+
+void node_types::visit_dostatement(dostatement *d) {
+	visit(d->stmt);
+	visit(d->cond);
+}
+
+void node_types::visit_repeatstatement(repeatstatement *r) {
+	visit(r->expr);
+	visit(r->stmt);
+}
+
+void node_types::visit_forstatement(forstatement *f) {
+	visit(f->init);
+	visit(f->cond);
+	visit(f->stmt);
+	visit(f->inc);
+}
+
+void node_types::visit_switchstatement(switchstatement *s) {
+	visit(s->expr);
+	visit(s->stmts);
+}
+
+void node_types::visit_withstatement(withstatement *w) {
+	visit(w->expr);
+	visit(w->stmt);
+}
+
+void node_types::visit_returnstatement(returnstatement *r) {
+	visit(r->expr);
+	returns.push_back(r->expr);
+}
+
+void node_types::visit_casestatement(casestatement *c) {
+	if (c->expr) visit(c->expr);
+}
@@ -2,12 +2,15 @@
 #define CODEGEN_H
 
 #include <dejavu/compiler/node_visitor.h>
+#include <dejavu/compiler/types.h>
+#include <dejavu/compiler/profile.h>
 #include <dejavu/compiler/error_stream.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
+#include <llvm/PassManager.h>
 #include <llvm/ADT/StringMap.h>
 #include <unordered_map>
-#include <unordered_set>
+#include <memory>
 #include <string>
 
 class node_codegen : public node_visitor<node_codegen, llvm::Value*> {
@@ -16,9 +19,35 @@ public:
 	llvm::Function *add_function(
 		node*, const char *name, size_t nargs, bool var
 	);
-	llvm::Module &get_module() { return module; }
 
-	void register_script(const std::string &name);
+	// the same, a top-level statement at a time, so the caller can throw each
+	// one away before the next. analysis needs the whole body, so every local
+	// stays boxed. begin_function returns null if name is already defined
+	llvm::Function *begin_function(const char *name, size_t nargs, bool var);
+	void add_statement(statement *stmt);
+	void end_function();
+	llvm::Module &get_module() { return *module; }
+
+	// hands off the module built so far and starts a fresh one, so units
+	// can be compiled into separate modules and linked later
+	std::unique_ptr<llvm::Module> take_module();
+
+	// every script has to be registered, with the same signature, before any
+	// unit that calls it is generated
+	void register_script(
+		const std::string &name, const script_signature &sig = script_signature()
+	);
+
+	// a function with the c signature game.cc expects, which calls script
+	// however it was registered. returns null if it isn't a script
+	llvm::Function *add_entry(llvm::StringRef name, llvm::StringRef script);
+
+	// data is only read when mode is profile_use, and has to outlive this
+	void set_profile(profile_mode mode, const profile_data *data = 0);
+
+	// cleans up each function as soon as it's generated, so modules stay
+	// small on their way to the linker. takes effect from the next function
+	void set_optimize(bool optimize);
 
 // really should be private
 	llvm::Value *visit_value(value *v);
@@ -45,14 +74,48 @@ public:
 	llvm::Value *visit_casestatement(casestatement *c);
 
 private:
+	void create_module();
+	void create_passes();
+	llvm::Function *start_function(
+		node *body, const char *name, size_t nargs, bool var
+	);
+	void return_default();
+	void intern_literals();
+	void register_profiles();
+
+	llvm::BranchInst *branch(
+		llvm::Value *cond, llvm::BasicBlock *t, llvm::BasicBlock *f
+	);
+	void increment(llvm::Value *counter);
+
 	llvm::Function *get_function(llvm::StringRef name, int args, bool var);
 	llvm::Function *get_operator(llvm::StringRef name, int args);
 
 	llvm::Value *get_real(double val);
 	llvm::Value *get_real(llvm::Value *val);
 	llvm::Value *get_string(llvm::StringRef val);
+	llvm::Value *get_literal(llvm::StringRef val);
+
+	// fields of a variant*
+	llvm::Value *type_ptr(llvm::Value *variant);
+	llvm::Value *real_ptr(llvm::Value *variant);
+
+	// unboxed doubles, for expressions node_types has proven are reals
+	llvm::Value *visit_real(expression *e);
+	llvm::Value *as_real(expression *e);
+	llvm::Value *real_unary(token_type op, llvm::Value *right);
+	llvm::Value *real_binary(
+		token_type op, llvm::Value *left, llvm::Value *right
+	);
+
+	// a double for scripts that only return reals, a ret_type otherwise
+	llvm::Value *emit_call(call *c);
 
-	llvm::Value *to_bool(node *val);
+	llvm::Value *to_bool(expression *val);
+	bool is_owned(assignment *a);
+	bool in_variable(expression *e);
+	llvm::Value *copy_variable(expression *e, llvm::Value *value);
+	expression *get_append(assignment *a);
 	llvm::Value *is_equal(llvm::Value *a, llvm::Value *b);
 
 	llvm::Value *make_local(llvm::StringRef name, llvm::Value *value);
@@ -64,6 +127,7 @@ private:
 	llvm::AllocaInst *alloc(llvm::Type*, const llvm::Twine&);
 	llvm::AllocaInst *alloc(llvm::Type*, llvm::Value*, const llvm::Twine&);
 
+	llvm::Value *get_slot(llvm::StringRef name);
 	llvm::Value *do_lookup(llvm::Value *left, llvm::Value *right, bool lvalue);
 	llvm::Value *do_lookup_default(
 		llvm::Value *right, bool lvalue
@@ -73,12 +137,17 @@ private:
 	const llvm::DataLayout dl;
 
 	llvm::IRBuilder<> builder;
-	llvm::Module module;
+	std::unique_ptr<llvm::Module> module;
 
+	// null unless optimizing, and rebuilt along with the module
+	bool optimize = false;
+	std::unique_ptr<llvm::FunctionPassManager> passes;
+
+	// a string* per literal, interned by the module's constructor
 	llvm::StringMap<llvm::GlobalVariable*> string_literals;
 
 	// todo: resolve namespace issues by mapping to llvm::Function*s
-	std::unordered_set<std::string> scripts;
+	script_signatures scripts;
 
 	// runtime types
 	llvm::PointerType *scope_type;
@@ -87,31 +156,40 @@ private:
 	llvm::StructType *ret_type;
 	llvm::Type *real_type;
 	llvm::Type *string_type;
+	llvm::StructType *cache_type;
+	llvm::StructType *iterator_type;
 	int union_diff;
 
 	// runtime functions
 	llvm::Function *to_real;
 	llvm::Function *to_string;
 
-	llvm::Function *intern;
+	llvm::Function *intern_literal;
+	llvm::Function *profile_register;
 
 	llvm::Function *insert_globalvar;
 	llvm::Function *lookup;
 	llvm::Function *lookup_default;
-	llvm::Function *access;
+	llvm::GlobalVariable *scope_epoch;
+	llvm::Function *access_var;
 
 	llvm::Function *retain;
 	llvm::Function *release;
 	llvm::Function *retain_var;
 	llvm::Function *release_var;
+	llvm::Function *append;
 
 	llvm::Function *with_begin;
 	llvm::Function *with_inc;
 
 	// scope handling
+	llvm::Function *current_function = 0;
+	node_types types;
 	std::unordered_map<std::string, llvm::Value*> scope;
+	std::unordered_map<std::string, llvm::Value*> reals;
 	llvm::Instruction *alloca_point = 0;
 	llvm::Value *return_value = 0;
+	bool returns_real = false;
 	llvm::Value *self_scope = 0;
 	llvm::Value *other_scope = 0;
 
@@ -122,13 +200,32 @@ private:
 	llvm::BasicBlock *current_default = 0;
 	llvm::Value *current_switch = 0;
 
+	// dispatch on constant labels, until the first label that isn't one
+	llvm::SwitchInst *current_reals = 0;
+	llvm::SwitchInst *current_strings = 0;
+	// the switch value as the pool's own string, to compare with literals
+	llvm::Value *current_string = 0;
+	std::unordered_map<uint64_t, llvm::BranchInst*> current_hashes;
+
 	bool lvalue = false;
 
+	// profiling
+	profile_mode profile = profile_none;
+	const profile_data *profile_source = 0;
+	uint64_t hot_calls = 1;
+	std::vector<llvm::GlobalVariable*> profiled;
+
+	unsigned profile_sites = 0;
+	llvm::GlobalVariable *profile_counters = 0;
+	const std::vector<uint64_t> *profile_counts = 0;
+
 	error_stream& errors;
 };
 
-inline void node_codegen::register_script(const std::string &name) {
-	scripts.insert(name);
+inline void node_codegen::register_script(
+	const std::string &name, const script_signature &sig
+) {
+	scripts[name] = sig;
 }
 
 inline llvm::AllocaInst *node_codegen::alloc(
@@ -28,6 +28,17 @@ struct unsupported_error {
 	token position;
 };
 
+// one finished phase of a build. times are in seconds from the start of the
+// build, and unit is empty for phases that cover the whole game. bytes is
+// what the parser allocated and instructions what codegen produced, where
+// those apply. thread 0 is the one that called build
+struct phase_timing {
+	std::string phase, unit;
+	double start, seconds;
+	size_t bytes, instructions;
+	unsigned thread;
+};
+
 struct error_stream {
 	virtual void set_context(const std::string &) = 0;
 	virtual int count() = 0;
@@ -38,6 +49,9 @@ struct error_stream {
 	virtual void error(const std::string &) = 0;
 
 	virtual void progress(int i, const std::string &) = 0;
+
+	// most streams only care about errors
+	virtual void timing(const phase_timing &) {}
 };
 
 #endif
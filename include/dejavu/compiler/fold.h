@@ -0,0 +1,55 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <dejavu/compiler/node_visitor.h>
+#include <dejavu/system/arena.h>
+
+// rewrites a function before codegen: real expressions made only of
+// constants become one value with the same result the inline real path would
+// compute, strings that are only concatenated or compared do the same, and
+// if, while, for and repeat branches that can never run are dropped. new
+// nodes go in the tree's arena
+class node_folder : public node_visitor<node_folder, node*> {
+public:
+	node_folder(arena &allocator) : allocator(allocator) {}
+
+	// the node to use in place of n, which may be n itself
+	node *fold(node *n);
+
+	// each of these returns its replacement, or null to keep the node
+	node *visit_unary(unary *u);
+	node *visit_binary(binary *b);
+	node *visit_subscript(subscript *s);
+	node *visit_call(call *c);
+
+	node *visit_assignment(assignment *a);
+	node *visit_invocation(invocation* i);
+	node *visit_block(block *b);
+
+	node *visit_ifstatement(ifstatement *i);
+	node *visit_whilestatement(whilestatement *w);
+	node *visit_dostatement(dostatement *d);
+	node *visit_repeatstatement(repeatstatement *r);
+	node *visit_forstatement(forstatement *f);
+	node *visit_switchstatement(switchstatement *s);
+	node *visit_withstatement(withstatement *w);
+
+	node *visit_returnstatement(returnstatement *r);
+	node *visit_casestatement(casestatement *c);
+
+private:
+	template <typename T>
+	T *fold_child(T *n) { return static_cast<T*>(fold(n)); }
+
+	template <typename T>
+	void fold_children(node_list<T> &children) {
+		for (T *&child : children) child = fold_child(child);
+	}
+
+	value *make_real(const token &position, double real);
+	statement *make_empty();
+
+	arena &allocator;
+};
+
+#endif
@@ -11,6 +11,12 @@ enum token_type {
 #include <dejavu/compiler/tokens.tbl>
 };
 
+// one past the last token type, for tables indexed by them
+const size_t token_count = 0
+#define TOK(X) + 1
+#include <dejavu/compiler/tokens.tbl>
+;
+
 std::ostream &operator <<(std::ostream &o, token_type t);
 
 struct token {
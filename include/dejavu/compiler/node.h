@@ -1,8 +1,9 @@
 #ifndef NODE_H
 #define NODE_H
 
-#include <vector>
 #include <dejavu/compiler/lexer.h>
+#include <dejavu/system/arena.h>
+#include <cstddef>
 
 enum node_type {
 #define NODE(X) X ## _node,
@@ -15,6 +16,30 @@ struct node {
 	node_type type;
 };
 
+// children are copied into the same arena as their parent, since nothing in
+// the arena is ever destroyed. the parser collects them somewhere else first
+template <typename T>
+struct node_list {
+	typedef T **iterator;
+
+	node_list() : data(0), count(0) {}
+
+	template <typename It>
+	node_list(arena &a, It first, It last) :
+		data(new (a) T*[last - first]), count(last - first) {
+		for (size_t i = 0; i < count; i++) data[i] = static_cast<T*>(first[i]);
+	}
+
+	iterator begin() const { return data; }
+	iterator end() const { return data + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T *operator[](size_t i) const { return data[i]; }
+
+	T **data;
+	size_t count;
+};
+
 struct expression : public node {
 	expression(node_type type) : node(type) {}
 };
@@ -46,19 +71,19 @@ struct binary : public expression {
 };
 
 struct subscript : public expression {
-	subscript(expression *array, std::vector<expression*>& indices) :
+	subscript(expression *array, node_list<expression> indices) :
 		expression(subscript_node), array(array), indices(indices) {}
 
 	expression *array;
-	std::vector<expression*> indices;
+	node_list<expression> indices;
 };
 
 struct call : public expression {
-	call(value *function, std::vector<expression*>& args) :
+	call(value *function, node_list<expression> args) :
 		expression(call_node), function(function), args(args) {}
 
 	value *function;
-	std::vector<expression*> args;
+	node_list<expression> args;
 };
 
 struct statement : public node {
@@ -84,18 +109,18 @@ struct invocation : public statement {
 };
 
 struct declaration : public statement {
-	declaration(token type, std::vector<value*>& names) :
+	declaration(token type, node_list<value> names) :
 		statement(declaration_node), type(type), names(names) {}
 
 	token type;
-	std::vector<value*> names;
+	node_list<value> names;
 };
 
 struct block : public statement {
-	block(std::vector<statement*>& stmts) :
+	block(node_list<statement> stmts) :
 		statement(block_node), stmts(stmts) {}
 
-	std::vector<statement*> stmts;
+	node_list<statement> stmts;
 };
 
 struct ifstatement : public statement {
@@ -7,7 +7,6 @@
 #include <dejavu/compiler/error_stream.h>
 #include <exception>
 #include <vector>
-#include <map>
 #include <algorithm>
 
 class parser {
@@ -17,6 +16,13 @@ public:
 	parser(token_stream& l, arena &allocator, error_stream& e);
 	node *getprogram();
 
+	// the program a top-level statement at a time, then null. nothing in the
+	// arena is needed by the next statement, so it can be reset between them
+	statement *getnext();
+
+	// a lone expression, such as a D&D action argument
+	expression *getfragment();
+
 private:
 	// expressions
 	expression *getexpression(int prec = 0);
@@ -61,33 +67,55 @@ private:
 	statement_error *error_stmt(const unexpected_token_error&);
 	expression_error *error_expr(const unexpected_token_error&);
 
+	// nested lists share one stack, so parsing doesn't allocate once it's
+	// grown. each list starts at the size it had before its first child
+	template <typename T>
+	node_list<T> take_children(size_t start);
+
 	token_stream& lexer;
 	token current;
 
 	arena &allocator;
 	error_stream& errors;
+
+	std::vector<node*> children;
 };
 
+template <typename T>
+inline node_list<T> parser::take_children(size_t start) {
+	node_list<T> list(allocator, children.begin() + start, children.end());
+	children.resize(start);
+	return list;
+}
+
 typedef statement *(parser::*std_parser)();
 typedef expression *(parser::*nud_parser)(token);
 typedef expression *(parser::*led_parser)(token, expression*);
 
 struct symbol {
-	int precedence;
-	std_parser std;
-	nud_parser nud;
-	led_parser led;
+	int precedence = 0;
+	std_parser std = nullptr;
+	nud_parser nud = nullptr;
+	led_parser led = nullptr;
 };
 
-class symbol_table : public std::map<token_type, symbol> {
+// built at compile time, so it's read-only and safe to share between threads.
+// tokens without an entry get a null symbol
+class symbol_table {
 public:
-	symbol_table();
+	constexpr symbol_table();
+
+	constexpr const symbol &operator[](token_type t) const { return table[t]; }
 
 private:
-	void prefix(token_type t, nud_parser nud = &parser::prefix_nud);
-	void infix(token_type t, int prec, led_parser led = &parser::infix_led);
+	constexpr void prefix(token_type t, nud_parser nud = &parser::prefix_nud);
+	constexpr void infix(
+		token_type t, int prec, led_parser led = &parser::infix_led
+	);
+
+	symbol table[token_count];
 };
 
-extern symbol_table symbols;
+extern const symbol_table symbols;
 
 #endif
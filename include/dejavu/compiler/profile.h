@@ -0,0 +1,22 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// an instrumented build counts how often each function is entered and which
+// way each of its branches goes. a build that uses the profile turns that
+// into branch weights and inlining hints
+enum profile_mode { profile_none, profile_instrument, profile_use };
+
+// counters by function name. the first is the number of calls, then each
+// branch has a pair- not taken, taken- in the order codegen emits them
+typedef std::unordered_map<std::string, std::vector<uint64_t>> profile_data;
+
+// the runtime writes one function per line: its name, the number of
+// counters, and the counters
+bool read_profile(const char *path, profile_data &profile);
+
+#endif
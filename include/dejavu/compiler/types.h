@@ -0,0 +1,89 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <dejavu/compiler/node_visitor.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <vector>
+
+// how a script can be called. a fixed script only reads argument at constant
+// indices below arity, so it takes that many arguments by value instead of an
+// array, and a real one only returns reals, so it returns a double
+struct script_signature {
+	bool real = false;
+	bool fixed = false;
+	unsigned arity = 0;
+};
+
+typedef std::unordered_map<std::string, script_signature> script_signatures;
+
+// proves which expressions in a function always produce reals, so codegen
+// can keep them unboxed. a local is a real if it's never subscripted, never
+// used before its declaration, and every assignment to it is a real
+class node_types : public node_visitor<node_types> {
+public:
+	void analyze(node *body, bool var);
+
+	bool is_real(expression *e);
+	bool is_real(const std::string &name);
+
+	// calls to scripts are reals when their signature says so. s has to
+	// outlive this
+	void set_scripts(const script_signatures *s) { scripts = s; }
+
+	// for the script analyze last saw, which has to have had a body
+	script_signature signature();
+
+	// past this many arguments, a script takes them as an array anyway
+	static const unsigned max_arity = 16;
+
+	void visit_value(value *v);
+	void visit_unary(unary *u);
+	void visit_binary(binary *b);
+	void visit_subscript(subscript *s);
+	void visit_call(call *c);
+
+	void visit_assignment(assignment *a);
+	void visit_invocation(invocation* i);
+	void visit_declaration(declaration *d);
+	void visit_block(block *b);
+
+	void visit_ifstatement(ifstatement *i);
+	void visit_whilestatement(whilestatement *w);
+	void visit_dostatement(dostatement *d);
+	void visit_repeatstatement(repeatstatement *r);
+	void visit_forstatement(forstatement *f);
+	void visit_switchstatement(switchstatement *s);
+	void visit_withstatement(withstatement *w);
+
+	void visit_returnstatement(returnstatement *r);
+	void visit_casestatement(casestatement *c);
+
+private:
+	struct store {
+		std::string name;
+		token_type op;
+		expression *rvalue;
+	};
+
+	std::unordered_set<std::string> declared;
+	std::unordered_set<std::string> boxed;
+	std::unordered_set<std::string> reals;
+	std::vector<store> stores;
+
+	void visit_argument(subscript *s);
+
+	const script_signatures *scripts = 0;
+	std::vector<expression*> returns;
+	bool fixed;
+	unsigned arity;
+};
+
+// operators whose real-real case codegen can emit inline
+bool is_real_op(token_type op);
+
+// the binary operator behind a compound assignment, or unexpected
+token_type compound_op(token_type op);
+
+#endif
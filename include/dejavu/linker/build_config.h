@@ -0,0 +1,34 @@
+#ifndef BUILD_CONFIG_H
+#define BUILD_CONFIG_H
+
+#include <dejavu/compiler/profile.h>
+#include <string>
+
+enum opt_level { opt_o0, opt_o1, opt_o2, opt_o3, opt_os };
+
+// everything about how a game is built, short of what it's built into. the
+// defaults are a release build for the host
+struct build_config {
+	opt_level opt = opt_o3;
+
+	// the game's own code, before the runtime is linked in
+	bool optimize_functions = true;
+	// the game and the runtime together, once they're linked
+	bool lto = true;
+
+	// empty means a generic cpu for the target. "native" means this one,
+	// features and all
+	std::string cpu;
+	std::string features;
+
+	// 0 means one per core
+	unsigned threads = 0;
+
+	profile_mode profile = profile_none;
+
+	// writes output/trace.json, which chrome://tracing and perfetto can open.
+	// timings go to the error stream either way
+	bool trace = false;
+};
+
+#endif
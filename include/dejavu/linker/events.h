@@ -0,0 +1,55 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <dejavu/compiler/node.h>
+#include <dejavu/system/arena.h>
+#include <string>
+
+struct action_type;
+struct action;
+struct argument;
+struct event;
+struct object;
+struct error_stream;
+
+std::string action_name(const action_type &type);
+std::string event_name(const object &obj, const event &evt);
+std::string code_name(const object &obj, const event &evt, unsigned int a);
+
+// actions that generate no code, and events made only of them, which the
+// linker leaves out of the game entirely
+bool is_empty(const action &act);
+bool is_empty(const event &evt);
+
+// builds an event's body straight from its D&D actions, in the arena. only
+// expression arguments go through the lexer and parser
+class event_builder {
+public:
+	event_builder(
+		const object &obj, const event &evt,
+		arena &allocator, error_stream &errors
+	);
+	node *getevent();
+
+private:
+	statement *getstatement();
+	statement *getnormal(const action &act);
+	expression *getargument(const argument &arg);
+	expression *getfragment(const char *code);
+
+	bool peek(int kind);
+	statement *error_stmt(token_type unexpected, const char *expected);
+
+	value *make_name(const std::string &name);
+	value *make_real(double real);
+	value *make_string(const char *data, size_t length);
+
+	const object &obj;
+	const event &evt;
+	unsigned int current;
+
+	arena &allocator;
+	error_stream &errors;
+};
+
+#endif
@@ -2,27 +2,65 @@
 #define LINKER_H
 
 #include <dejavu/compiler/codegen.h>
+#include <dejavu/linker/build_config.h>
+#include <chrono>
+#include <vector>
 
 struct game;
+struct action_type;
+struct object;
+struct event;
 struct error_stream;
 
 namespace llvm {
 	class DataLayout;
+	class TargetMachine;
 }
 
+// runtime.bc is read once per process and parsed lazily into each context
+llvm::Module *load_runtime(llvm::LLVMContext &context);
+
+// what the linker writes to the target file. emit_jit runs the game in this
+// process instead, with the target as its name
+enum emit_kind { emit_bitcode, emit_object, emit_executable, emit_jit };
+
 class linker {
 public:
 	linker(
 		const char *output, game&, error_stream&,
-		const std::string &triple, llvm::LLVMContext &context
+		llvm::Module &runtime, llvm::TargetMachine &target
+	);
+
+	// an instrumented game writes output/profile when it exits, which
+	// profile_use reads back
+	bool build(
+		const char *target, const build_config &config,
+		emit_kind emit = emit_executable
 	);
-	bool build(const char *target, bool debug);
 
 private:
-	bool link(const char *target, bool debug);
+	// a single function to be compiled- a script, action or event
+	struct unit {
+		std::string name;
+		std::string code;
+		int args;
+		bool var;
+
+		// events are built from their actions rather than parsed from code
+		const object *obj;
+		const event *evt;
+	};
+
+	bool link(const char *target, emit_kind emit);
+	bool run_jit(std::unique_ptr<llvm::Module> game, const char *name);
+	bool write_bitcode(llvm::Module &game, const char *target);
+	bool write_object(llvm::Module &game, const char *target);
+	bool link_executable(const char *object, const char *target);
 
+	void find_libraries();
 	void build_libraries();
 	void build_scripts();
+	void analyze_scripts();
 	void build_objects();
 
 	void add_function(
@@ -30,13 +68,78 @@ private:
 		const std::string &name, int args, bool var
 	);
 
+	void compile(unsigned jobs);
+	void compile_parallel(
+		unsigned jobs, const std::vector<const unit*> &todo,
+		const std::vector<size_t> &misses, const std::vector<std::string> &paths,
+		std::vector<std::unique_ptr<llvm::Module>> &modules
+	);
+	void compile_unit(
+		node_codegen &compiler, error_stream &e, const unit &u,
+		unsigned thread = 0
+	);
+	llvm::Function *stream_unit(
+		node_codegen &compiler, error_stream &e, const unit &u,
+		token_stream &tokens, arena &allocator
+	);
+
+	// incremental build cache, stored in output/cache
+	std::string build_key();
+	std::string library_key();
+	static std::string unit_key(const std::string &prefix, const unit &u);
+	std::unique_ptr<llvm::Module> load_cached(const std::string &path);
+	static void store_cached(const std::string &path, llvm::StringRef bitcode);
+
+	// output/trace.json, from every timing the build reported
+	void write_trace();
+
+	// passes everything on to the caller's stream, keeping the timings for
+	// the trace when there is one
+	class build_stream : public error_stream {
+	public:
+		build_stream(error_stream &e) : out(e) {}
+
+		void set_context(const std::string &c) { out.set_context(c); }
+		int count() { return out.count(); }
+
+		void error(const unexpected_token_error &e) { out.error(e); }
+		void error(const redefinition_error &e) { out.error(e); }
+		void error(const unsupported_error &e) { out.error(e); }
+		void error(const std::string &e) { out.error(e); }
+
+		void progress(int i, const std::string &n) { out.progress(i, n); }
+		void timing(const phase_timing &t);
+
+		// phase_timing is relative to this
+		std::chrono::steady_clock::time_point started;
+		bool tracing = false;
+		std::vector<phase_timing> timings;
+
+	private:
+		error_stream &out;
+	};
+
 	llvm::LLVMContext &context;
-	std::unique_ptr<llvm::Module> runtime;
+	std::string runtime_digest;
+	llvm::Module &runtime;
+	llvm::TargetMachine &target;
 	const char *output;
 
 	game &source;
-	error_stream &errors;
+	build_stream errors;
 	node_codegen compiler;
+	std::unique_ptr<llvm::Module> objects;
+	std::unique_ptr<llvm::Module> actions;
+
+	std::vector<unit> units;
+	// what node_types proves about each script, before any calls are generated
+	script_signatures signatures;
+
+	// the library actions the game can reach, from find_libraries
+	std::vector<const action_type*> libraries;
+
+	build_config config;
+	profile_data profile_counts;
 };
 
 #endif
@@ -0,0 +1,34 @@
+#ifndef PACKED_GAME_H
+#define PACKED_GAME_H
+
+#include <dejavu/linker/game.h>
+#include <cstddef>
+#include <vector>
+
+// a whole game in one buffer, as written by Writer.pack(). every field is 32
+// bits in native byte order, and a string is its length, its bytes, a nul and
+// padding up to the next field. the game's strings and argument types point
+// straight into the buffer rather than being copied, so it has to outlive this
+class packed_game {
+public:
+	packed_game(const char *data, size_t size);
+
+	packed_game(const packed_game&) = delete;
+	packed_game &operator=(const packed_game&) = delete;
+
+	// false if the buffer ended early or doesn't describe a game
+	bool valid() const { return ok; }
+	game &get() { return source; }
+
+private:
+	game source;
+	std::vector<action_type> action_types;
+	std::vector<script> scripts;
+	std::vector<object> objects;
+	std::vector<event> events;
+	std::vector<action> actions;
+	std::vector<argument> arguments;
+	bool ok;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef PROJECT_FILE_H
+#define PROJECT_FILE_H
+
+#include <dejavu/linker/packed_game.h>
+#include <dejavu/system/file.h>
+#include <memory>
+
+// a packed game saved to disk, so games can be built without lateralgm. the
+// file is "djvp", a format version, and then exactly what Writer.pack()
+// produces. it's mapped rather than read, and the game points into the
+// mapping, so only the code a build actually looks at is paged in
+class project_file {
+public:
+	// 0 on success, otherwise an errno. EINVAL means the file isn't a
+	// project, or was written with the other byte order
+	int open_file(const char *path);
+
+	game &get() { return packed->get(); }
+
+private:
+	file_buffer file;
+	std::unique_ptr<packed_game> packed;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <dejavu/runtime/scope.h>
+#include <cstdint>
+#include <vector>
+
+// every object in the game indexed by id, holding its parent or -1. the
+// linker fills these in the same way it fills in slot_names
+extern "C" const unsigned object_count;
+extern "C" const int object_parents[];
+
+// the slots each object's instances have, sorted, from object_layouts[
+// object_layout_offsets[i]] up to object_layout_offsets[i + 1]. an object's
+// layout is every slot its own code uses, and everything its parents' has
+extern "C" const unsigned object_layouts[];
+extern "C" const unsigned object_layout_offsets[];
+
+struct instance : scope {
+	instance(double id, unsigned object) :
+		scope(
+			&object_layouts[object_layout_offsets[object]],
+			object_layout_offsets[object + 1] - object_layout_offsets[object]
+		),
+		id(id), object(object) {}
+
+	double id;
+	unsigned object;
+
+	// position in its object's pool
+	unsigned index = -1;
+
+	// destroyed, but still in the pool until the next flush. nothing finds,
+	// counts or visits it in the meantime
+	bool dead = false;
+};
+
+// each object's instances are listed in one array, so with and instance_*
+// only visit instances of the objects they ask for. the list holds pointers,
+// and each instance is still its own scope on the heap. descendants is the
+// object itself followed by everything that inherits from it, which is what
+// with (obj) visits
+struct object_pool {
+	std::vector<instance*> instances;
+	std::vector<unsigned> descendants;
+
+	// instances that aren't dead
+	size_t live = 0;
+};
+
+// instance_create appends to its pool right away, but instance_destroy only
+// marks the instance dead, since something up the stack may still be running
+// in it. this takes dead instances out of their pools and frees them, so
+// only call it between events, when nothing is
+void flush_instances();
+
+// filled in by with_begin and walked by with_inc. a single instance (self,
+// other, or an id) is returned by with_begin and leaves nothing to walk.
+// instances created during the with have ids from limit up, and are skipped
+struct with_iterator {
+	const unsigned *object, *end;
+	unsigned index;
+	double limit;
+};
+
+// the instance with this id, or the first instance of this object
+instance *find_instance(double id);
+
+// only scopes that are instances can be destroyed
+instance *as_instance(scope *s);
+
+extern "C" {
+	scope *with_begin(
+		with_iterator *it, scope *self, scope *other, variant *target
+	);
+	scope *with_inc(with_iterator *it);
+}
+
+template<>
+struct hash<scope*> {
+	size_t operator()(const scope *s) const {
+		return reinterpret_cast<uintptr_t>(s) / alignof(scope);
+	}
+};
+
+template<>
+struct equal<scope*> {
+	bool operator()(const scope *a, const scope *b) const { return a == b; }
+};
+
+#endif
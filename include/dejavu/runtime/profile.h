@@ -0,0 +1,17 @@
+#ifndef RUNTIME_PROFILE_H
+#define RUNTIME_PROFILE_H
+
+#include <cstdint>
+
+// where profile_dump writes to, filled in by the linker
+extern "C" const char profile_path[];
+
+// instrumented code registers each function's counters from a constructor
+extern "C" void profile_register(
+	const char *name, uint64_t *counters, unsigned count
+);
+
+// does nothing unless the game was built with instrumentation
+void profile_dump();
+
+#endif
@@ -3,7 +3,72 @@
 
 #include <dejavu/runtime/variant.h>
 #include <dejavu/system/table.h>
+#include <algorithm>
 
-struct scope : public table<string*, var> {};
+// every variable name the compiler sees gets a slot, numbered by the linker,
+// so those are an index into the scope rather than a hash lookup. names that
+// only show up at runtime go in the table
+extern "C" const unsigned slot_count;
+extern "C" const char *const slot_names[];
+
+// the slot for an interned name, or -1
+int slot_of(string *name);
+
+// the interned name of a slot
+string *slot_name(unsigned slot);
+
+// bumped whenever a scope goes away, which invalidates every lookup_cache
+extern "C" unsigned scope_epoch;
+
+// a scope with a layout only has those slots, sorted, so an instance pays for
+// the names its object uses rather than every name in the game. any other
+// slot lives in dynamic under its name, like a name only seen at runtime
+struct scope {
+	scope() : scope(nullptr, slot_count) {}
+	scope(const unsigned *layout, unsigned nslots) :
+		layout(layout), nslots(nslots), slots(new var[nslots]()) {}
+	~scope() { delete[] slots; scope_epoch++; }
+
+	scope(const scope&) = delete;
+	scope &operator=(const scope&) = delete;
+
+	// null if the variable doesn't exist yet
+	var *find(string *name);
+	var &operator[](string *name);
+
+	// frees what every variable holds, slots and dynamic alike
+	void release_vars();
+
+	// null if the layout doesn't have it
+	var *slot(unsigned i) {
+		if (!layout) return &slots[i];
+
+		const unsigned *p = std::lower_bound(layout, layout + nslots, i);
+		return p != layout + nslots && *p == i ? &slots[p - layout] : nullptr;
+	}
+
+	// null for every slot in order
+	const unsigned *layout;
+	unsigned nslots;
+	var *slots;
+
+	// most names are slots, so the few that aren't usually fit inline
+	typedef table<string*, var, hash<string*>, equal<string*>, 2> dynamic_table;
+	dynamic_table dynamic;
+};
+
+// each obj.field site in generated code gets one of these. codegen checks it
+// inline and only calls lookup_cached on a miss
+struct lookup_cache {
+	double id;
+	scope *self, *other;
+	unsigned epoch;
+	var *result;
+};
+
+extern "C" var *lookup_cached(
+	lookup_cache *cache,
+	scope *self, scope *other, double id, unsigned slot, bool lvalue
+);
 
 #endif
@@ -5,11 +5,16 @@
 
 extern string_pool strings;
 
+// scratch space for temporaries. there's no step to reset it after yet, so
+// each user marks it and releases back to the mark once anything that
+// escapes has been copied out, the way plus_string_string does
+extern arena frame;
+
 struct variant {
 	variant() = default;
 
 	variant(double r) : type(0), real(r) {}
-	variant(string *s) : type(1), string(s) {}
+	variant(::string *s) : type(1), string(s) {}
 
 	variant(const char *s) : variant(strings.intern(s)) {}
 
@@ -17,12 +22,16 @@ struct variant {
 	unsigned char type;
 	union {
 		double real;
-		string *string;
+		::string *string;
 	};
 };
 
+// x by y elements, in rows stride apart with room for rows of them. a stride
+// of 0 means contents is borrowed, like a script's arguments, and growing
+// copies it rather than freeing it
 struct var {
-	unsigned short x, y;
+	unsigned x, y;
+	unsigned stride, rows;
 	variant *contents;
 };
 
@@ -31,16 +40,17 @@ extern "C" {
 	string *to_string(const variant &a);
 
 	string *intern(string *s) __attribute__((pure));
+	string *intern_literal(string *s);
 
-	variant *access(
-		var *a, unsigned short x, unsigned short y, bool lvalue = false
-	);
+	variant *access_var(var *a, unsigned x, unsigned y, bool lvalue = false);
 
 	void retain(variant *a);
 	void release(variant *a);
 
 	void retain_var(var *a);
 	void release_var(var *a);
+
+	void append(variant *a, variant *b);
 }
 
 #endif
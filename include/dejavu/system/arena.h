@@ -3,33 +3,67 @@
 
 #include <cstddef>
 
+// bump allocator. nothing is freed individually- reset throws everything away
+// at once and keeps the slabs around for the next round
 class arena {
+	struct slab;
+
 public:
+	// a point to roll back to, for scratch space that doesn't outlive a call
+	struct marker {
+		slab *current_slab;
+		slab *large_slabs;
+		char *current;
+		char *end;
+		size_t bytes_allocated;
+	};
+
 	arena(size_t slab_size = 4096);
 	~arena();
 
-	void *allocate(size_t s);
+	arena(const arena&) = delete;
+	arena &operator=(const arena&) = delete;
+
+	void *allocate(size_t s, size_t align = alignof(std::max_align_t));
 	void reset();
 
+	// release frees everything allocated since mark, most recent mark first
+	marker mark() const;
+	void release(const marker &m);
+
+	// everything handed out since the last reset, not counting alignment
+	size_t bytes() const { return bytes_allocated; }
+
 private:
 	struct slab {
 		size_t size;
 		slab *next;
 	};
 
-	void new_slab();
+	void next_slab();
+	void *allocate_large(size_t s, size_t align);
+	static void free_slabs(slab *s);
 
 	size_t slab_size;
+
+	// slabs in the order they were first used, so reset can reuse them
+	slab *first_slab;
 	slab *current_slab;
+
+	// allocations too big for a slab get their own, freed on reset
+	slab *large_slabs;
+
 	char *current;
 	char *end;
 	size_t bytes_allocated;
-
-	size_t offset = 0;
 };
 
 inline void *operator new (size_t size, arena &a) {
 	return a.allocate(size);
 }
 
+inline void *operator new[] (size_t size, arena &a) {
+	return a.allocate(size);
+}
+
 #endif
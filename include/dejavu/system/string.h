@@ -2,7 +2,9 @@
 #define STRING_H
 
 #include <dejavu/system/table.h>
+#include <dejavu/system/arena.h>
 #include <cstring>
+#include <vector>
 
 class string_pool;
 
@@ -16,6 +18,9 @@ struct string final {
 	static void *operator new(size_t s, int len = 0) {
 		return ::operator new(s + len);
 	}
+	static void *operator new(size_t s, arena &a, int len) {
+		return a.allocate(s + len, alignof(string));
+	}
 
 	void retain() { refcount++; }
 	void release();
@@ -27,6 +32,10 @@ struct string final {
 
 	size_t hash;
 	size_t length;
+
+	// non-zero for a builder- a string that's being appended to in place. it
+	// has no hash and isn't in the pool until something interns it
+	size_t capacity = 0;
 	char data[];
 };
 
@@ -42,42 +51,85 @@ struct equal<string*> {
 	}
 };
 
+// open addressing with linear probing over a power-of-two array. the hashes
+// sit next to the pointers so a probe only touches a string when they match,
+// and removal shifts later entries back instead of leaving tombstones
 class string_pool {
 	friend struct string;
 
-	struct empty {};
-
-	struct equal {
-		bool operator()(const string *a, const string *b) {
-			return
-				a->hash == b->hash && a->length == b->length &&
-				memcmp(a->data, b->data, a->length) == 0;
-		}
+	struct slot {
+		size_t hash;
+		string *str;
 	};
 
-	typedef table<string*, empty, hash<string*>, equal> string_table;
-
 public:
+	string_pool() = default;
+	~string_pool() { delete[] slots; }
+
+	string_pool(const string_pool&) = delete;
+	string_pool &operator=(const string_pool&) = delete;
+
 	string *intern(const char *str) {
 		return intern(str, strlen(str));
 	}
-	string *intern(const char *str, size_t len) {
-		return intern(new (len) string(len, str));
-	}
+	string *intern(const char *str, size_t len);
 	string *intern(string *str);
 
-	size_t size() { return pool.size(); }
-	bool empty() { return pool.empty(); }
+	// for a string that won't outlive its arena. it's only copied to the heap
+	// if the pool doesn't already have it
+	string *intern_temporary(string *str);
+
+	// builders need interning before they can be used as names
+	string *canonical(string *str) {
+		return str->capacity > 0 ? intern(str) : str;
+	}
+
+	size_t size() { return count; }
+	bool empty() { return size() == 0; }
+
+	// while a batch is open, strings that drop to zero references are only
+	// freed at the end, so temporaries don't churn the table- and any that get
+	// retained again in the meantime survive. a batch that runs long is swept
+	// every batch_limit deaths, so it holds on to a bounded number of them
+	void begin_batch() { batch++; }
+	void end_batch();
+
+	static const size_t batch_limit = 4096;
 
 private:
-	string_table pool;
+	void collect(string *str);
+	void sweep();
+
+	// the slot holding this string's twin, or the empty slot it would go in
+	slot *find(size_t hash, size_t length, const char *data);
+	void insert(slot *s, string *str);
+	void remove(string *str);
+	void resize(size_t length);
+
+	slot *slots = nullptr;
+	size_t mask = 0;
+	size_t count = 0;
+
+	size_t batch = 0;
+	std::vector<string*> dead;
 };
 
 inline void string::release() {
 	if (--refcount == 0) {
-		pool->pool.remove(this);
-		delete this;
+		pool->collect(this);
 	}
 }
 
+inline void string_pool::collect(string *str) {
+	if (batch > 0) {
+		// str itself is queued after the sweep, so it can still be revived
+		if (dead.size() >= batch_limit) sweep();
+		dead.push_back(str);
+		return;
+	}
+
+	if (str->capacity == 0) remove(str);
+	delete str;
+}
+
 #endif
@@ -10,24 +10,50 @@ struct hash;
 template <class k>
 struct equal;
 
+template <class key, class value>
+struct table_node {
+	key k;
+	value v;
+	table_node *next;
+};
+
+// the first few nodes live in the table itself, so a small table never
+// touches the heap. tables without any don't pay for the array
+template <class node, size_t n>
+struct table_storage {
+	node *local() { return nodes; }
+	node nodes[n];
+};
+
+template <class node>
+struct table_storage<node, 0> {
+	node *local() { return nullptr; }
+};
+
 /*
  * Lua-style hash table- chained scatter table with Brent's variation
  * Brent's variation avoids coalescing by relocating colliding keys that are
  * not in their main position
+ *
+ * the length is always a power of two, so main positions are a mask rather
+ * than a division. up to small nodes are stored inline, and while the table
+ * still fits there a lookup just scans them
  */
 template <
-	class key, class value, class hash = hash<key>, class equal = equal<key>
+	class key, class value, class hash = hash<key>, class equal = equal<key>,
+	size_t small = 0
 >
-class table {
+class table : private table_storage<table_node<key, value>, small> {
+	static_assert((small & (small - 1)) == 0, "small must be a power of two");
+
 public:
-	struct node {
-		key k;
-		value v;
-		node *next;
-	};
+	typedef table_node<key, value> node;
+
+	table(size_t s = 1) { resize(round_up(s)); }
+	~table() { free_contents(); }
 
-	table(size_t s = 1) { resize(s); }
-	~table() { delete[] contents; }
+	table(const table&) = delete;
+	table &operator=(const table&) = delete;
 
 	value &operator[](const key &k) {
 		node *p = find(k);
@@ -70,6 +96,13 @@ public:
 	}
 
 	node *find(const key &k) {
+		if (length <= small) {
+			for (node *n = contents; n != end(); n++) {
+				if (!is_empty(n) && equal()(k, n->k)) return n;
+			}
+			return end();
+		}
+
 		node *n = main_position(k);
 
 		if (is_empty(n))
@@ -85,43 +118,89 @@ public:
 		return end();
 	}
 
+	// every key in a chain shares its main position, so the node before a
+	// tail is always found from there
 	void remove(const key &k) {
 		node *n = find(k);
 		if (n == end())
 			return;
 
+		node *freed = n;
 		if (n->next) {
-			node *next = n->next;
-			*n = *next;
-
-			next->next = end();
-			if (next > lastfree)
-				lastfree = next + 1;
+			freed = n->next;
+			*n = *freed;
 		}
 		else {
-			n->next = end();
+			node *main = main_position(k);
+			if (main != n) {
+				while (main->next != n) main = main->next;
+				main->next = nullptr;
+			}
 		}
 
+		freed->next = end();
+		if (freed >= lastfree)
+			lastfree = freed + 1;
+
 		count--;
 	}
 
+	// grows so that n keys fit without another resize
+	void reserve(size_t n) {
+		if (n > length) resize(round_up(n));
+	}
+
 	node *end() {
 		return contents + length;
 	}
 
+	// every node in use, in no particular order. inserting or removing while
+	// iterating moves nodes around
+	class iterator {
+	public:
+		iterator(node *n, node *last) : n(n), last(last) { skip(); }
+
+		node &operator*() const { return *n; }
+		node *operator->() const { return n; }
+
+		iterator &operator++() { n++; skip(); return *this; }
+		bool operator!=(const iterator &i) const { return n != i.n; }
+
+	private:
+		void skip() { while (n != last && n->next == last) n++; }
+
+		node *n, *last;
+	};
+
+	struct range {
+		iterator first, last;
+		iterator begin() const { return first; }
+		iterator end() const { return last; }
+	};
+
+	range nodes() {
+		return range{ iterator(contents, end()), iterator(end(), end()) };
+	}
+
 	size_t size() { return count; }
 	bool empty() { return size() == 0; }
 	size_t capacity() { return length; }
 
 private:
+	static size_t round_up(size_t s) {
+		size_t n = small > 0 ? small : 1;
+		while (n < s) n *= 2;
+		return n;
+	}
+
 	void resize(size_t s) {
-		assert(s > 0);
+		assert(s > 0 && (s & (s - 1)) == 0);
 
 		node *old_contents = contents;
 		size_t old_length = length;
 
 		length = s;
-		contents = new node[length];
+		contents = s <= small ? this->local() : new node[length];
 		lastfree = end();
 		for (size_t i = 0; i < length; i++) {
 			contents[i].next = end();
@@ -130,17 +209,21 @@ private:
 		size_t old_count = count;
 		for (size_t i = 0; i < old_length; i++) {
 			node *old = &old_contents[i];
-			if (!is_empty(old)) {
+			if (old->next != old_contents + old_length) {
 				(*this)[old->k] = old->v;
 			}
 		}
 		count = old_count;
 
-		delete[] old_contents;
+		if (old_contents != this->local()) delete[] old_contents;
+	}
+
+	void free_contents() {
+		if (contents != this->local()) delete[] contents;
 	}
 
 	node *main_position(const key &k) {
-		return &contents[hash()(k) % length];
+		return &contents[hash()(k) & (length - 1)];
 	}
 
 	bool is_empty(node *n) {
@@ -0,0 +1,249 @@
+#include <dejavu/linker/events.h>
+#include <dejavu/linker/game.h>
+#include <dejavu/compiler/lexer.h>
+#include <dejavu/compiler/parser.h>
+#include <dejavu/compiler/error_stream.h>
+#include <dejavu/system/buffer.h>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+std::string action_name(const action_type &type) {
+	std::ostringstream name;
+	name << "action_lib";
+	if (type.parent > -1) name << type.parent;
+	name << "_" << type.id;
+	return name.str();
+}
+
+std::string event_name(const object &obj, const event &evt) {
+	std::ostringstream name;
+	name << obj.name << "_" << evt.main_id << "_" << evt.sub_id;
+	return name.str();
+}
+
+std::string code_name(const object &obj, const event &evt, unsigned int a) {
+	std::ostringstream name;
+	name << event_name(obj, evt) << "_" << a;
+	return name.str();
+}
+
+event_builder::event_builder(
+	const object &obj, const event &evt, arena &allocator, error_stream &errors
+) : obj(obj), evt(evt), current(0), allocator(allocator), errors(errors) {}
+
+// this mirrors how the actions would parse as one line of GML each, so errors
+// are reported with the action's position as the row
+node *event_builder::getevent() {
+	std::vector<statement*> stmts;
+	while (true) {
+		while (current < evt.nactions && is_empty(evt.actions[current]))
+			current++;
+		if (current == evt.nactions)
+			break;
+
+		stmts.push_back(getstatement());
+	}
+
+	return new (allocator) block(
+		node_list<statement>(allocator, stmts.begin(), stmts.end())
+	);
+}
+
+statement *event_builder::getstatement() {
+	while (current < evt.nactions && is_empty(evt.actions[current]))
+		current++;
+	if (current == evt.nactions)
+		return error_stmt(eof, "statement");
+
+	unsigned int index = current;
+	const action &act = evt.actions[current++];
+	switch (act.type->kind) {
+	case action_type::act_begin: {
+		std::vector<statement*> stmts;
+		while (!peek(action_type::act_end)) {
+			if (current == evt.nactions)
+				return error_stmt(eof, "}");
+
+			stmts.push_back(getstatement());
+		}
+		current++;
+
+		return new (allocator) block(
+			node_list<statement>(allocator, stmts.begin(), stmts.end())
+		);
+	}
+
+	case action_type::act_end:
+		current--;
+		return error_stmt(r_brace, "statement");
+	case action_type::act_else:
+		current--;
+		return error_stmt(kw_else, "statement");
+
+	case action_type::act_exit:
+		return new (allocator) jump(kw_exit);
+
+	case action_type::act_repeat: {
+		expression *count = getfragment(act.args[0].val);
+		statement *stmt = getstatement();
+		return new (allocator) repeatstatement(count, stmt);
+	}
+
+	case action_type::act_variable: {
+		expression *lvalue = getfragment(act.args[0].val);
+		expression *rvalue = getfragment(act.args[1].val);
+		return new (allocator) assignment(
+			act.relative ? plus_equals : equals, lvalue, rvalue
+		);
+	}
+
+	case action_type::act_code: {
+		call *c = new (allocator) call(
+			make_name(code_name(obj, evt, index)), node_list<expression>()
+		);
+		return new (allocator) invocation(c);
+	}
+
+	case action_type::act_normal:
+		return getnormal(act);
+
+	default: /* is_empty skips everything else */
+		return 0;
+	}
+}
+
+statement *event_builder::getnormal(const action &act) {
+	std::vector<expression*> args;
+	for (unsigned int n = 0; n < act.nargs; n++) {
+		args.push_back(getargument(act.args[n]));
+	}
+	if (act.type->relative) {
+		args.push_back(make_real(act.relative));
+	}
+
+	std::string name = act.type->exec == action_type::exec_code ?
+		action_name(*act.type) : std::string(act.type->code);
+	call *c = new (allocator) call(
+		make_name(name),
+		node_list<expression>(allocator, args.begin(), args.end())
+	);
+
+	statement *stmt;
+	if (act.type->question) {
+		expression *cond = c;
+		if (act.inv) cond = new (allocator) unary(exclaim, c);
+
+		statement *branch_true = getstatement();
+
+		statement *branch_false = 0;
+		if (peek(action_type::act_else)) {
+			current++;
+			branch_false = getstatement();
+		}
+
+		stmt = new (allocator) ifstatement(cond, branch_true, branch_false);
+	}
+	else {
+		stmt = new (allocator) invocation(c);
+	}
+
+	if (act.target != action::self) {
+		stmt = new (allocator) withstatement(make_real(act.target), stmt);
+	}
+
+	return stmt;
+}
+
+expression *event_builder::getargument(const argument &arg) {
+	switch (arg.kind) {
+	case argument::arg_expr:
+	case argument::arg_menu:
+		return getfragment(arg.val);
+
+	case argument::arg_both:
+		if (arg.val[0] == '"' || arg.val[0] == '\'') return getfragment(arg.val);
+
+	// fall through
+	case argument::arg_string:
+		return make_string(arg.val, strlen(arg.val));
+
+	case argument::arg_bool:
+		return make_real(arg.val[0] == '0');
+
+	case argument::arg_color:
+		return make_real(strtoul(arg.val, 0, 16));
+
+	default:
+		return make_real(arg.resource);
+	}
+}
+
+// the game data outlives the build, so tokens can point straight into it
+expression *event_builder::getfragment(const char *code) {
+	buffer b(strlen(code), code);
+	token_stream tokens(b);
+	parser p(tokens, allocator, errors);
+	return p.getfragment();
+}
+
+bool is_empty(const action &act) {
+	switch (act.type->kind) {
+	case action_type::act_normal:
+		return act.type->exec == action_type::exec_none;
+
+	case action_type::act_begin: case action_type::act_end:
+	case action_type::act_else: case action_type::act_exit:
+	case action_type::act_repeat: case action_type::act_variable:
+	case action_type::act_code:
+		return false;
+
+	default:
+		return true;
+	}
+}
+
+bool is_empty(const event &evt) {
+	for (unsigned int a = 0; a < evt.nactions; a++) {
+		if (!is_empty(evt.actions[a])) return false;
+	}
+	return true;
+}
+
+// skips to the next action that generates code and checks its kind
+bool event_builder::peek(int kind) {
+	while (current < evt.nactions && is_empty(evt.actions[current]))
+		current++;
+
+	return current < evt.nactions && evt.actions[current].type->kind == kind;
+}
+
+statement *event_builder::error_stmt(token_type t, const char *expected) {
+	errors.error(unexpected_token_error(token(t, current + 1, 1), expected));
+	if (current < evt.nactions) current++;
+	return new (allocator) statement_error;
+}
+
+value *event_builder::make_name(const std::string &name) {
+	char *data = static_cast<char*>(allocator.allocate(name.size()));
+	memcpy(data, name.data(), name.size());
+
+	token t(v_name, current + 1, 1);
+	t.string.data = data;
+	t.string.length = name.size();
+	return new (allocator) value(t);
+}
+
+value *event_builder::make_real(double real) {
+	token t(v_real, current + 1, 1);
+	t.real = real;
+	return new (allocator) value(t);
+}
+
+value *event_builder::make_string(const char *data, size_t length) {
+	token t(v_string, current + 1, 1);
+	t.string.data = data;
+	t.string.length = length;
+	return new (allocator) value(t);
+}
@@ -1,14 +1,17 @@
 #include <dejavu/linker/linker.h>
 #include <dejavu/linker/game.h>
+#include <dejavu/linker/events.h>
 
 #include <dejavu/compiler/lexer.h>
 #include <dejavu/compiler/parser.h>
+#include <dejavu/compiler/fold.h>
 #include <dejavu/compiler/codegen.h>
 #include <dejavu/system/buffer.h>
 
 #include <llvm/PassManager.h>
 #include <llvm/Analysis/Passes.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/IR/Instructions.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
@@ -19,99 +22,637 @@
 
 #include <llvm/Support/TargetRegistry.h>
 #include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetSubtargetInfo.h>
 #include <llvm/IR/DataLayout.h>
 
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+
 #include <llvm/Support/ToolOutputFile.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/FormattedStream.h>
+#include <llvm/Support/Format.h>
 
 #include <sstream>
+#include <cstring>
 #include <algorithm>
 #include <memory>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <thread>
 
 using namespace llvm;
 
-static Module *load_module(const char *filename, LLVMContext &context) {
-	std::unique_ptr<MemoryBuffer> file = std::move(MemoryBuffer::getFile(filename).get());
-	return getLazyBitcodeModule(std::move(file), context).get();
+// bump this whenever code generation changes, to invalidate old caches
+static const char cache_version[] = "dejavu-cache-21";
+
+// scripts this big, usually generated data tables, are parsed and compiled a
+// statement at a time so the tree never has to fit in memory all at once
+static const size_t stream_size = 1 << 20;
+
+// runtime/game.cc starts the game by calling entry_name, which runs this script
+static const char entry_script[] = "scr_0";
+static const char entry_name[] = "game_entry";
+
+static void hash_string(MD5 &hash, StringRef s) {
+	uint64_t length = s.size();
+	hash.update(ArrayRef<uint8_t>(
+		reinterpret_cast<const uint8_t*>(&length), sizeof(length)
+	));
+	hash.update(s);
+}
+
+// in name order, since the map's order isn't stable between builds
+static void hash_signatures(MD5 &hash, const script_signatures &signatures) {
+	std::vector<const script_signatures::value_type*> scripts;
+	for (const script_signatures::value_type &entry : signatures) {
+		scripts.push_back(&entry);
+	}
+	std::sort(scripts.begin(), scripts.end(), [](
+		const script_signatures::value_type *a,
+		const script_signatures::value_type *b
+	) {
+		return a->first < b->first;
+	});
+
+	for (const script_signatures::value_type *entry : scripts) {
+		const script_signature &sig = entry->second;
+		hash_string(hash, entry->first);
+		hash_string(hash, sig.real ? "real" : "boxed");
+		hash_string(hash, sig.fixed ? std::to_string(sig.arity) : "var");
+	}
+}
+
+static std::string digest(MD5 &hash) {
+	MD5::MD5Result result;
+	hash.final(result);
+
+	SmallString<32> str;
+	MD5::stringifyResult(result, str);
+	return str.str();
+}
+
+// runtime.bc doesn't change while the process is running, so it's read and
+// hashed once and then parsed lazily into each context that needs it
+namespace {
+struct runtime_file {
+	runtime_file() :
+		buffer(std::move(MemoryBuffer::getFile("runtime.bc").get())) {
+		MD5 md5;
+		md5.update(buffer->getBuffer());
+		hash = digest(md5);
+	}
+
+	std::unique_ptr<MemoryBuffer> buffer;
+	std::string hash;
+};
+
+const runtime_file &get_runtime_file() {
+	static const runtime_file file;
+	return file;
+}
+}
+
+Module *load_runtime(LLVMContext &context) {
+	std::unique_ptr<MemoryBuffer> ref = MemoryBuffer::getMemBuffer(
+		get_runtime_file().buffer->getMemBufferRef(), false
+	);
+	return getLazyBitcodeModule(std::move(ref), context).get();
+}
+
+// linkonce definitions are only linked (and materialized) once something in
+// the game references them, so the runtime is pulled in function by function
+static void select_runtime(Module &runtime) {
+	for (Function &f : runtime) {
+		if (f.isDeclaration() || !f.hasExternalLinkage()) continue;
+		if (f.getName() == "main") continue;
+
+		f.setLinkage(GlobalValue::LinkOnceODRLinkage);
+	}
+}
+
+static void diagnostic_handler(const DiagnosticInfo &DI) {
+	fprintf(stderr, "AUGHERASER\n");
+}
+
+static void configure(PassManagerBuilder &pmb, const build_config &config) {
+	switch (config.opt) {
+	case opt_o0: pmb.OptLevel = 0; break;
+	case opt_o1: pmb.OptLevel = 1; break;
+	case opt_o2: pmb.OptLevel = 2; break;
+	case opt_o3: pmb.OptLevel = 3; break;
+	case opt_os: pmb.OptLevel = 2; pmb.SizeLevel = 1; break;
+	}
+
+	if (pmb.OptLevel > 1)
+		pmb.Inliner = createFunctionInliningPass(pmb.OptLevel, pmb.SizeLevel);
+}
+
+static bool optimizes_functions(const build_config &config) {
+	return config.optimize_functions && config.opt != opt_o0;
+}
+
+static void optimize_module(Module &module, const build_config &config) {
+	PassManager pm;
+	PassManagerBuilder pmb;
+	configure(pmb, config);
+	pmb.populateModulePassManager(pm);
+	pm.run(module);
+}
+
+namespace {
+
+// collects a worker thread's errors so they can be replayed in unit order
+class error_buffer : public error_stream {
+public:
+	void set_context(const std::string &c) {
+		log.push_back([c](error_stream &e) { e.set_context(c); });
+	}
+	int count() { return errors; }
+
+	void error(const unexpected_token_error &e) { record(e); }
+	void error(const redefinition_error &e) { record(e); }
+	void error(const unsupported_error &e) { record(e); }
+	void error(const std::string &e) { record(e); }
+
+	void progress(int, const std::string &) {}
+
+	void timing(const phase_timing &t) {
+		log.push_back([t](error_stream &e) { e.timing(t); });
+	}
+
+	void replay(error_stream &e) {
+		for (auto &entry : log) entry(e);
+	}
+
+	void clear() {
+		log.clear();
+		errors = 0;
+	}
+
+private:
+	template <typename T>
+	void record(const T &x) {
+		log.push_back([x](error_stream &e) { e.error(x); });
+		errors++;
+	}
+
+	std::vector<std::function<void(error_stream&)>> log;
+	int errors = 0;
+};
+
+typedef std::chrono::steady_clock build_clock;
+
+// reports everything from here to the end of its scope as one phase. bytes
+// and instructions are filled in along the way
+class phase_timer {
+public:
+	phase_timer(
+		error_stream &e, build_clock::time_point origin,
+		const char *phase, const std::string &unit = "", unsigned thread = 0
+	) : e(e), origin(origin), begin(build_clock::now()),
+		phase(phase), unit(unit), thread(thread) {}
+
+	~phase_timer() {
+		typedef std::chrono::duration<double> seconds;
+		e.timing(phase_timing{
+			phase, unit,
+			seconds(begin - origin).count(), seconds(build_clock::now() - begin).count(),
+			bytes, instructions, thread
+		});
+	}
+
+	size_t bytes = 0, instructions = 0;
+
+private:
+	error_stream &e;
+	build_clock::time_point origin, begin;
+	const char *phase;
+	std::string unit;
+	unsigned thread;
+};
+
+}
+
+static size_t count_instructions(const Function *f) {
+	if (!f) return 0;
+
+	size_t count = 0;
+	for (const BasicBlock &block : *f) count += block.size();
+	return count;
+}
+
+static size_t count_instructions(const Module &module) {
+	size_t count = 0;
+	for (const Function &f : module) count += count_instructions(&f);
+	return count;
+}
+
+void linker::build_stream::timing(const phase_timing &t) {
+	if (tracing) timings.push_back(t);
+	out.timing(t);
 }
 
 linker::linker(
 	const char *output, game &g, error_stream &e,
-	const std::string &triple, LLVMContext &context
-) : context(context), runtime(load_module("runtime.bc", context)),
-	output(output), source(g), errors(e), compiler(*runtime, errors) {
-	verifyModule(*runtime);
-}
+	Module &runtime, TargetMachine &target
+) : context(runtime.getContext()), runtime_digest(get_runtime_file().hash),
+	runtime(runtime), target(target),
+	output(output), source(g), errors(e), compiler(runtime, errors) {}
 
-bool linker::build(const char *target, bool debug) {
-	errors.progress(20, "compiling libraries");
-	build_libraries();
+bool linker::build(
+	const char *target, const build_config &config, emit_kind emit
+) {
+	this->config = config;
+	errors.started = build_clock::now();
+	errors.tracing = config.trace;
+	errors.timings.clear();
 
-	errors.progress(30, "compiling scripts");
-	build_scripts();
+	if (config.profile == profile_use) {
+		std::string path = std::string(output) + "/profile";
+		if (!read_profile(path.c_str(), profile_counts)) {
+			errors.error("no profile at " + path + " - run an instrumented build first");
+			return false;
+		}
+	}
+	compiler.set_profile(config.profile, &profile_counts);
+	compiler.set_optimize(optimizes_functions(config));
+
+	// first, so every code generator knows which functions are scripts and
+	// how each one is called
+	{
+		phase_timer timer(errors, errors.started, "analyze scripts");
+		analyze_scripts();
+	}
 
-	errors.progress(40, "compiling objects");
+	errors.progress(20, "compiling libraries");
+	{
+		phase_timer timer(errors, errors.started, "libraries");
+		build_libraries();
+	}
+	build_scripts();
 	build_objects();
 
-	if (errors.count() > 0) return false;
+	errors.progress(30, "compiling");
+	unsigned jobs = config.threads;
+	if (jobs == 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+	{
+		phase_timer timer(errors, errors.started, "compile");
+		compile(jobs);
+	}
 
-	Module &game = compiler.get_module();
+	if (errors.count() > 0) {
+		write_trace();
+		return false;
+	}
+
+	Module &game = *objects;
 	{
+		phase_timer timer(errors, errors.started, "verify");
+		timer.instructions = count_instructions(game);
+
 		SmallString<80> str;
 		raw_svector_ostream error(str);
 		if (verifyModule(game, &error)) {
 			game.dump();
 			errors.error(error.str());
-			return false;
 		}
 	}
+	if (errors.count() > 0) {
+		write_trace();
+		return false;
+	}
 
-	if (!debug) {
-		PassManager pm;
-		PassManagerBuilder pmb;
-		pmb.populateModulePassManager(pm);
-		pm.run(game);
+	if (optimizes_functions(config)) {
+		phase_timer timer(errors, errors.started, "optimize");
+		optimize_module(game, config);
+		timer.instructions = count_instructions(game);
 	}
 
-	{
-		std::error_code error;
-		std::ostringstream f; f << output << "/objects.bc";
-		tool_output_file out(f.str(), error, sys::fs::F_None);
-		if (error) {
-			errors.error(error.message());
-			return false;
+	errors.progress(60, "linking runtime");
+	link(target, emit);
+
+	write_trace();
+	return errors.count() == 0;
+}
+
+// every instance or global variable name in the game gets a slot in each
+// scope. they're numbered in name order so builds are reproducible, and the
+// runtime gets the names so it can map dynamic lookups onto the same slots
+static void assign_slots(Module &game) {
+	std::vector<GlobalVariable*> slots;
+	for (GlobalVariable &global : game.globals()) {
+		if (global.isDeclaration() && global.getName().startswith("slot."))
+			slots.push_back(&global);
+	}
+	std::sort(slots.begin(), slots.end(), [](GlobalVariable *a, GlobalVariable *b) {
+		return a->getName() < b->getName();
+	});
+
+	LLVMContext &context = game.getContext();
+	Type *int_type = Type::getInt32Ty(context);
+	Type *name_type = Type::getInt8PtrTy(context);
+
+	std::vector<Constant*> names;
+	for (size_t i = 0; i < slots.size(); i++) {
+		slots[i]->setInitializer(ConstantInt::get(int_type, i));
+		slots[i]->setLinkage(GlobalValue::InternalLinkage);
+
+		Constant *name = ConstantDataArray::getString(
+			context, slots[i]->getName().substr(strlen("slot."))
+		);
+		GlobalVariable *data = new GlobalVariable(
+			game, name->getType(), true, GlobalValue::PrivateLinkage, name
+		);
+		data->setUnnamedAddr(true);
+		names.push_back(ConstantExpr::getBitCast(data, name_type));
+	}
+
+	if (GlobalVariable *count = game.getNamedGlobal("slot_count")) {
+		count->setInitializer(ConstantInt::get(int_type, slots.size()));
+		count->setConstant(true);
+	}
+
+	// the runtime declares slot_names without a size, so it needs replacing
+	if (GlobalVariable *decl = game.getNamedGlobal("slot_names")) {
+		ArrayType *type = ArrayType::get(name_type, names.size());
+		GlobalVariable *table = new GlobalVariable(
+			game, type, true, GlobalValue::ExternalLinkage,
+			ConstantArray::get(type, names)
+		);
+		table->takeName(decl);
+		decl->replaceAllUsesWith(ConstantExpr::getBitCast(table, decl->getType()));
+		decl->eraseFromParent();
+	}
+}
+
+// a function's own slots are the ones it loads, and its events reach an
+// object's code and everything that calls. an instance also runs what it
+// inherits, so each layout has its parents' slots too. code that uses a name
+// on some other object's instance leaves it to that instance's dynamic table
+static void assign_layouts(
+	Module &game, const struct game &source,
+	const std::vector<uint32_t> &parents
+) {
+	std::unordered_map<const Function*, std::vector<unsigned>> uses;
+	for (GlobalVariable &global : game.globals()) {
+		if (!global.getName().startswith("slot.") || !global.hasInitializer())
+			continue;
+
+		unsigned slot = cast<ConstantInt>(global.getInitializer())->getZExtValue();
+		for (User *user : global.users()) {
+			if (Instruction *i = dyn_cast<Instruction>(user))
+				uses[i->getParent()->getParent()].push_back(slot);
 		}
+	}
+
+	size_t count = parents.size();
+	std::vector<std::vector<uint32_t>> own(count);
+	for (unsigned i = 0; i < source.nobjects; i++) {
+		const object &obj = source.objects[i];
 
-		WriteBitcodeToFile(&game, out.os());
-		out.keep();
+		std::vector<const Function*> stack;
+		for (unsigned e = 0; e < obj.nevents; e++) {
+			if (Function *f = game.getFunction(event_name(obj, obj.events[e])))
+				stack.push_back(f);
+		}
+
+		std::unordered_set<const Function*> seen;
+		while (!stack.empty()) {
+			const Function *f = stack.back();
+			stack.pop_back();
+			if (!seen.insert(f).second) continue;
+
+			auto it = uses.find(f);
+			if (it != uses.end()) {
+				own[obj.id].insert(
+					own[obj.id].end(), it->second.begin(), it->second.end()
+				);
+			}
+
+			for (const BasicBlock &block : *f) {
+				for (const Instruction &inst : block) {
+					const CallInst *call = dyn_cast<CallInst>(&inst);
+					const Function *callee = call ? call->getCalledFunction() : 0;
+					if (callee && !callee->isDeclaration()) stack.push_back(callee);
+				}
+			}
+		}
 	}
 
-	errors.progress(60, "linking runtime");
-	link(target, debug);
+	// a cycle of parents just stops once it's been all the way round
+	std::vector<uint32_t> layouts, offsets;
+	for (size_t i = 0; i < count; i++) {
+		offsets.push_back(layouts.size());
 
-	return errors.count() == 0;
+		std::vector<uint32_t> layout;
+		uint32_t p = i;
+		for (size_t n = 0; p != (uint32_t)-1 && n < count; n++) {
+			layout.insert(layout.end(), own[p].begin(), own[p].end());
+			p = parents[p];
+		}
+		std::sort(layout.begin(), layout.end());
+		layout.erase(std::unique(layout.begin(), layout.end()), layout.end());
+		layouts.insert(layouts.end(), layout.begin(), layout.end());
+	}
+	offsets.push_back(layouts.size());
+
+	LLVMContext &context = game.getContext();
+	Type *int_type = Type::getInt32Ty(context);
+	std::pair<const char*, std::vector<uint32_t>*> tables[] = {
+		{ "object_layouts", &layouts }, { "object_layout_offsets", &offsets }
+	};
+	for (auto &t : tables) {
+		GlobalVariable *decl = game.getNamedGlobal(t.first);
+		if (!decl) continue;
+
+		ArrayType *type = ArrayType::get(int_type, t.second->size());
+		GlobalVariable *table = new GlobalVariable(
+			game, type, true, GlobalValue::ExternalLinkage,
+			ConstantDataArray::get(context, *t.second)
+		);
+		table->takeName(decl);
+		decl->replaceAllUsesWith(ConstantExpr::getBitCast(table, decl->getType()));
+		decl->eraseFromParent();
+	}
 }
 
-static void diagnostic_handler(const DiagnosticInfo &DI) {
-	fprintf(stderr, "AUGHERASER\n");
+// the runtime builds its instance pools from this. objects are indexed by id,
+// and a parent that doesn't exist is treated as none
+static void assign_objects(Module &game, const struct game &source) {
+	unsigned count = 0;
+	for (unsigned i = 0; i < source.nobjects; i++)
+		count = std::max(count, source.objects[i].id + 1);
+
+	std::vector<uint32_t> parents(count, -1);
+	for (unsigned i = 0; i < source.nobjects; i++) {
+		const object &obj = source.objects[i];
+		if (obj.parent >= 0 && (unsigned)obj.parent < count)
+			parents[obj.id] = obj.parent;
+	}
+
+	LLVMContext &context = game.getContext();
+	Type *int_type = Type::getInt32Ty(context);
+
+	if (GlobalVariable *decl = game.getNamedGlobal("object_count")) {
+		decl->setInitializer(ConstantInt::get(int_type, count));
+		decl->setConstant(true);
+	}
+
+	if (GlobalVariable *decl = game.getNamedGlobal("object_parents")) {
+		ArrayType *type = ArrayType::get(int_type, count);
+		GlobalVariable *table = new GlobalVariable(
+			game, type, true, GlobalValue::ExternalLinkage,
+			ConstantDataArray::get(context, parents)
+		);
+		table->takeName(decl);
+		decl->replaceAllUsesWith(ConstantExpr::getBitCast(table, decl->getType()));
+		decl->eraseFromParent();
+	}
+
+	assign_layouts(game, source, parents);
+}
+
+// the runtime declares profile_path without a size, like slot_names
+static void assign_profile_path(Module &game, const char *output) {
+	GlobalVariable *decl = game.getNamedGlobal("profile_path");
+	if (!decl) return;
+
+	Constant *path = ConstantDataArray::getString(
+		game.getContext(), std::string(output) + "/profile"
+	);
+	GlobalVariable *data = new GlobalVariable(
+		game, path->getType(), true, GlobalValue::ExternalLinkage, path
+	);
+	data->takeName(decl);
+	decl->replaceAllUsesWith(ConstantExpr::getBitCast(data, decl->getType()));
+	decl->eraseFromParent();
 }
 
-bool linker::link(const char *target, bool debug) {
-	std::ostringstream f; f << output << "/objects.bc";
-	std::unique_ptr<Module> objects(load_module(f.str().c_str(), context));
+// linking moves function bodies out of the modules it links in, so the
+// session's runtime stays untouched and a fresh lazy copy is linked instead
+bool linker::link(const char *target, emit_kind emit) {
+	std::unique_ptr<Module> runtime(load_runtime(context));
+	select_runtime(*runtime);
 
 	std::unique_ptr<Module> game = std::make_unique<Module>("game", context);
-	Linker L(game.get(), &diagnostic_handler);
-	if (L.linkInModule(objects.get()) || L.linkInModule(runtime.get()))
-		errors.error("failed to link with runtime");
+	game->setTargetTriple(this->target.getTargetTriple());
+	if (const DataLayout *dl = this->target.getSubtargetImpl()->getDataLayout())
+		game->setDataLayout(dl);
 
-	if (!debug) {
+	{
+		phase_timer timer(errors, errors.started, "link runtime");
+
+		Linker L(game.get(), &diagnostic_handler);
+		if (
+			L.linkInModule(objects.get()) || L.linkInModule(actions.get()) ||
+			L.linkInModule(runtime.get())
+		)
+			errors.error("failed to link with runtime");
+
+		assign_slots(*game);
+		assign_objects(*game, source);
+		assign_profile_path(*game, output);
+		timer.instructions = count_instructions(*game);
+	}
+
+	if (config.lto && config.opt != opt_o0) {
+		phase_timer timer(errors, errors.started, "lto");
 		PassManager pm;
 		PassManagerBuilder pmb;
-		pmb.OptLevel = 3;
+		configure(pmb, config);
 		pmb.populateLTOPassManager(pm);
 		pm.run(*game);
+		timer.instructions = count_instructions(*game);
+	}
+
+	switch (emit) {
+	case emit_jit: return run_jit(std::move(game), target);
+	case emit_bitcode: return write_bitcode(*game, target);
+	case emit_object: return write_object(*game, target);
+
+	case emit_executable: {
+		std::string object = std::string(target) + ".o";
+		if (!write_object(*game, object.c_str())) return false;
+
+		bool linked = link_executable(object.c_str(), target);
+		sys::fs::remove(object);
+		return linked;
 	}
+	}
+
+	return false;
+}
+
+// mcjit runs llvm.global_ctors in array order and ignores their priorities.
+// linking puts the game's units ahead of the runtime, so without this every
+// intern_literals would run before the string pool it interns into exists
+static void sort_constructors(Module &game) {
+	GlobalVariable *ctors = game.getNamedGlobal("llvm.global_ctors");
+	if (!ctors || !ctors->hasInitializer()) return;
+
+	ConstantArray *init = dyn_cast<ConstantArray>(ctors->getInitializer());
+	if (!init) return;
+
+	std::vector<Constant*> entries;
+	for (Use &entry : init->operands())
+		entries.push_back(cast<Constant>(entry));
+
+	auto priority = [](Constant *entry) {
+		return cast<ConstantInt>(entry->getOperand(0))->getZExtValue();
+	};
+	std::stable_sort(entries.begin(), entries.end(), [&](Constant *a, Constant *b) {
+		return priority(a) < priority(b);
+	});
+
+	ctors->setInitializer(ConstantArray::get(init->getType(), entries));
+}
+
+// mcjit compiles the whole module up front- lazy per-function compilation
+// needs orc, which this version of llvm doesn't have. the runtime is already
+// linked in, so only libc and friends are resolved from the process
+bool linker::run_jit(std::unique_ptr<Module> game, const char *name) {
+	Module &module = *game;
+	sort_constructors(module);
+
+	std::string error;
+	std::unique_ptr<ExecutionEngine> engine(EngineBuilder(std::move(game))
+		.setErrorStr(&error)
+		.setMCJITMemoryManager(std::make_unique<SectionMemoryManager>())
+		.create());
+	if (!engine) {
+		errors.error("failed to start jit: " + error);
+		return false;
+	}
+
+	Function *main = module.getFunction("main");
+	if (!main) {
+		errors.error("game has no main function");
+		return false;
+	}
+
+	errors.progress(100, "running");
+
+	// the game can run for as long as it likes, so the trace can't wait
+	{
+		phase_timer timer(errors, errors.started, "jit");
+		engine->finalizeObject();
+	}
+	write_trace();
+	engine->runStaticConstructorsDestructors(false);
+	engine->runFunctionAsMain(main, { name }, nullptr);
+	engine->runStaticConstructorsDestructors(true);
+
+	return true;
+}
+
+bool linker::write_bitcode(Module &game, const char *target) {
+	phase_timer timer(errors, errors.started, "write bitcode");
 
 	std::error_code error;
 	tool_output_file out(target, error, sys::fs::F_None);
@@ -120,35 +661,210 @@ bool linker::link(const char *target, bool debug) {
 		return false;
 	}
 
-	WriteBitcodeToFile(game.get(), out.os());
+	WriteBitcodeToFile(&game, out.os());
 	out.keep();
 
 	return true;
 }
 
+// code generation runs on the optimized module in memory, so there's no
+// bitcode round trip through llc
+bool linker::write_object(Module &game, const char *target) {
+	phase_timer timer(errors, errors.started, "emit object");
+
+	std::error_code error;
+	tool_output_file out(target, error, sys::fs::F_None);
+	if (error) {
+		errors.error(error.message());
+		return false;
+	}
+
+	PassManager pm;
+	pm.add(new DataLayoutPass());
+
+	formatted_raw_ostream os(out.os());
+	if (this->target.addPassesToEmitFile(pm, os, TargetMachine::CGFT_ObjectFile)) {
+		errors.error("target can't emit object files");
+		return false;
+	}
+	pm.run(game);
+
+	os.flush();
+	out.keep();
+
+	return true;
+}
+
+// the runtime is already linked into the object, so the system compiler driver
+// only needs to add the C++ standard library and startup files
+bool linker::link_executable(const char *object, const char *target) {
+	phase_timer timer(errors, errors.started, "link executable");
+
+	ErrorOr<std::string> cxx = sys::findProgramByName("c++");
+	if (!cxx) {
+		errors.error("unable to find the system linker (c++)");
+		return false;
+	}
+
+	const char *args[] = { cxx.get().c_str(), object, "-o", target, nullptr };
+	std::string message;
+	if (sys::ExecuteAndWait(cxx.get(), args, nullptr, nullptr, 0, 0, &message)) {
+		errors.error("failed to link " + std::string(target) + ": " + message);
+		return false;
+	}
+
+	return true;
+}
+
+// the libraries compile to a module of their own, kept in output/actions.bc
+// and tagged with a hash of the library set it was built from
+std::string linker::library_key() {
+	MD5 hash;
+	hash_string(hash, cache_version);
+	hash_string(hash, runtime_digest);
+	hash_string(hash, std::to_string(config.opt));
+	hash_string(hash, config.optimize_functions ? "optimized" : "unoptimized");
+	hash_signatures(hash, signatures);
+	for (const action_type *library : libraries) {
+		const action_type &type = *library;
+		hash_string(hash, action_name(type));
+		hash_string(hash, type.code);
+		hash_string(hash, std::to_string(type.nargs));
+		hash_string(hash, type.relative ? "relative" : "absolute");
+	}
+	return digest(hash);
+}
+
+static const char library_tag[] = "dejavu.libraries";
+
+static bool is_library(Module &module, const std::string &key) {
+	NamedMDNode *tag = module.getNamedMetadata(library_tag);
+	if (!tag || tag->getNumOperands() != 1) return false;
+
+	MDNode *node = tag->getOperand(0);
+	if (node->getNumOperands() != 1) return false;
+
+	MDString *str = dyn_cast<MDString>(node->getOperand(0));
+	return str && str->getString() == key;
+}
+
 void linker::build_libraries() {
-	for (unsigned int i = 0; i < source.nactions; i++) {
-		if (source.actions[i].exec != action_type::exec_code)
-			continue;
+	std::ostringstream path; path << output << "/actions.bc";
 
-		std::ostringstream name;
-		name << "action_lib";
-		if (source.actions[i].parent > -1) name << source.actions[i].parent;
-		name << "_" << source.actions[i].id;
+	find_libraries();
+	std::string key = library_key();
+	actions = load_cached(path.str());
+	if (actions && is_library(*actions, key)) return;
 
-		size_t nargs = source.actions[i].nargs;
-		if (source.actions[i].relative) nargs++;
-		add_function(
-			strlen(source.actions[i].code), source.actions[i].code,
-			name.str().c_str(), nargs, false
-		);
+	// library code can call the game's scripts, so it's built against their
+	// signatures, which are part of the key
+	node_codegen library(runtime, errors);
+	for (auto &entry : signatures) {
+		library.register_script(entry.first, entry.second);
+	}
+	for (const action_type *library_type : libraries) {
+		const action_type &type = *library_type;
+		size_t nargs = type.nargs;
+		if (type.relative) nargs++;
+		compile_unit(library, errors, unit{
+			action_name(type), type.code, (int)nargs, false
+		});
 	}
+
+	actions = library.take_module();
+	if (errors.count() > 0) return;
+
+	if (optimizes_functions(config)) optimize_module(*actions, config);
+
+	NamedMDNode *tag = actions->getOrInsertNamedMetadata(library_tag);
+	tag->addOperand(MDNode::get(context, MDString::get(context, key)));
+
+	std::string bitcode;
+	raw_string_ostream out(bitcode);
+	WriteBitcodeToFile(actions.get(), out);
+	store_cached(path.str(), out.str());
 }
 
-void linker::build_scripts() {
-	// first pass so the code generator knows which functions are scripts
+// library actions are only called by name, from the events that use them or
+// from code that spells the name out, so the rest never make it into
+// actions.bc. library code can use other actions, so this runs until nothing
+// new turns up
+void linker::find_libraries() {
+	std::unordered_set<std::string> used;
+
+	// hardly any code mentions a library action, so most of it is only
+	// searched once
+	std::vector<const char*> mentions;
+	auto scan = [&](const char *code) {
+		if (strstr(code, "action_lib")) mentions.push_back(code);
+	};
+
 	for (unsigned int i = 0; i < source.nscripts; i++) {
-		compiler.register_script(std::string(source.scripts[i].name));
+		scan(source.scripts[i].code);
+	}
+
+	for (unsigned int i = 0; i < source.nobjects; i++) {
+		object &obj = source.objects[i];
+		for (unsigned int e = 0; e < obj.nevents; e++) {
+			event &evt = obj.events[e];
+			for (unsigned int a = 0; a < evt.nactions; a++) {
+				action &act = evt.actions[a];
+				if (is_empty(act)) continue;
+
+				if (act.type->exec == action_type::exec_code) {
+					used.insert(action_name(*act.type));
+				}
+
+				for (unsigned int n = 0; n < act.nargs; n++) {
+					argument &arg = act.args[n];
+					switch (arg.kind) {
+					case argument::arg_expr: case argument::arg_menu:
+					case argument::arg_both: case argument::arg_string:
+						scan(arg.val);
+						break;
+
+					default:
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	std::vector<bool> scanned(source.nactions, false);
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (unsigned int i = 0; i < source.nactions; i++) {
+			const action_type &type = source.actions[i];
+			if (type.exec != action_type::exec_code || scanned[i])
+				continue;
+
+			std::string name = action_name(type);
+			if (!used.count(name)) {
+				bool mentioned = false;
+				for (const char *code : mentions) {
+					if (strstr(code, name.c_str())) { mentioned = true; break; }
+				}
+				if (!mentioned) continue;
+				used.insert(name);
+			}
+
+			scanned[i] = true;
+			scan(type.code);
+			changed = true;
+		}
+	}
+
+	libraries.clear();
+	for (unsigned int i = 0; i < source.nactions; i++) {
+		if (scanned[i]) libraries.push_back(&source.actions[i]);
+	}
+}
+
+void linker::build_scripts() {
+	for (auto &entry : signatures) {
+		compiler.register_script(entry.first, entry.second);
 	}
 
 	for (unsigned int i = 0; i < source.nscripts; i++) {
@@ -159,7 +875,65 @@ void linker::build_scripts() {
 	}
 }
 
-std::ostream &operator <<(std::ostream &out, const argument &arg);
+// scripts start out returning reals, and lose that as soon as one of their
+// returns might not be one- the same as node_types does with locals, so
+// recursive scripts can stay real. anything too big to parse all at once, or
+// that doesn't parse, keeps the default signature. its errors are reported when
+// it's compiled
+void linker::analyze_scripts() {
+	signatures.clear();
+
+	struct parsed {
+		std::string name;
+		node *program;
+	};
+	std::vector<parsed> programs;
+
+	arena allocator;
+	error_buffer unit_errors;
+	for (unsigned int i = 0; i < source.nscripts; i++) {
+		const script &scr = source.scripts[i];
+		signatures[scr.name] = script_signature();
+
+		size_t length = strlen(scr.code);
+		if (length >= stream_size) continue;
+
+		buffer code(length, scr.code);
+		token_stream tokens(code);
+		parser parser(tokens, allocator, unit_errors);
+		node *program = parser.getprogram();
+		if (unit_errors.count() > 0) {
+			unit_errors.clear();
+			continue;
+		}
+
+		programs.push_back(parsed{ scr.name, node_folder(allocator).fold(program) });
+	}
+	for (const parsed &p : programs) {
+		signatures[p.name].real = true;
+	}
+
+	node_types types;
+	types.set_scripts(&signatures);
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (const parsed &p : programs) {
+			types.analyze(p.program, true);
+			script_signature sig = types.signature();
+
+			script_signature &current = signatures[p.name];
+			current.fixed = sig.fixed;
+			current.arity = sig.arity;
+			if (current.real && !sig.real) {
+				current.real = false;
+				changed = true;
+			}
+		}
+	}
+}
+
 void linker::build_objects() {
 	for (unsigned int i = 0; i < source.nobjects; i++) {
 		object &obj = source.objects[i];
@@ -169,125 +943,356 @@ void linker::build_objects() {
 			event &evt = obj.events[e];
 			// todo: output event data
 
-			// todo: move this into compiler
-			std::ostringstream code;
+			// nothing calls an event by name, so one with no code just goes
+			if (is_empty(evt)) continue;
+
 			for (unsigned int a = 0; a < evt.nactions; a++) {
 				action &act = evt.actions[a];
+				if (act.type->kind != action_type::act_code) continue;
 
-				// todo: don't do this by unparsing and reparsing
-				switch (act.type->kind) {
-				case action_type::act_begin: code << "{\n"; break;
-				case action_type::act_end: code << "}\n"; break;
-				case action_type::act_else: code << "else\n"; break;
-				case action_type::act_exit: code << "exit\n"; break;
-
-				case action_type::act_repeat:
-					code << "repeat (" << act.args[0].val << ")\n";
-					break;
-				case action_type::act_variable:
-					code
-						<< act.args[0].val
-						<< (act.relative ? " += " : " = ")
-						<< act.args[1].val << "\n";
-					break;
-
-				case action_type::act_code: {
-					std::ostringstream s;
-					s << obj.name << "_" << evt.main_id << "_" << evt.sub_id << "_" << a;
-					add_function(strlen(act.args[0].val), act.args[0].val, s.str(), 0, false);
-
-					code << s.str() << "()\n";
-					break;
-				}
+				add_function(
+					strlen(act.args[0].val), act.args[0].val,
+					code_name(obj, evt, a), 0, false
+				);
+			}
 
-				case action_type::act_normal: {
-					if (act.type->exec == action_type::exec_none) break;
+			// the event itself is built from its actions in compile_unit
+			units.push_back(unit{ event_name(obj, evt), "", 0, false, &obj, &evt });
+		}
+	}
+}
 
-					if (act.target != action::self) code << "with (" << act.target << ")";
-					if (act.type->question) code << "if (";
-					if (act.inv) code << '!';
+void linker::add_function(
+	size_t length, const char *data,
+	const std::string &name, int args, bool var
+) {
+	units.push_back(unit{ name, std::string(data, length), args, var });
+}
 
-					if (act.type->exec == action_type::exec_code) {
-						code << "action_lib";
-						if (act.type->parent > -1) code << act.type->parent;
-						code << "_" << act.type->id;
-					}
-					else
-						code << act.type->code;
-
-					code << '(';
-					unsigned int n = 0;
-					for (; n < act.nargs; n++) {
-						if (n != 0) code << ", ";
-						code << act.args[n];
-					}
-					if (act.type->relative) {
-						code << ", " << act.relative;
-					}
-					code << ')';
+// events have no code of their own, so hash the actions they're built from
+static void hash_event(MD5 &hash, const event &evt) {
+	for (unsigned int a = 0; a < evt.nactions; a++) {
+		const action &act = evt.actions[a];
+		hash_string(hash, std::to_string(act.type->kind));
+		hash_string(hash, std::to_string(act.type->exec));
+		hash_string(hash, act.type->question ? "question" : "");
+		hash_string(hash, act.type->relative ? "relative" : "");
+		if (act.type->exec == action_type::exec_code)
+			hash_string(hash, action_name(*act.type));
+		else if (act.type->exec == action_type::exec_function)
+			hash_string(hash, act.type->code);
 
-					if (act.type->question) code << ')';
+		hash_string(hash, act.relative ? "relative" : "absolute");
+		hash_string(hash, act.inv ? "not" : "");
+		hash_string(hash, std::to_string(act.target));
+		for (unsigned int n = 0; n < act.nargs; n++) {
+			hash_string(hash, std::to_string(act.args[n].kind));
+			hash_string(hash, act.args[n].val);
+			hash_string(hash, std::to_string(act.args[n].resource));
+		}
+	}
+}
 
-					code << '\n';
-					break;
-				}
+// units are keyed on everything that affects their code: the compiler and
+// runtime, the set of scripts (which changes how calls are generated), the
+// profile, whether functions are optimized and of course the unit itself
+std::string linker::unit_key(const std::string &prefix, const unit &u) {
+	MD5 hash;
+	hash_string(hash, prefix);
+	hash_string(hash, u.name);
+	hash_string(hash, u.code);
+	hash_string(hash, std::to_string(u.args));
+	hash_string(hash, u.var ? "var" : "fixed");
+	if (u.evt) hash_event(hash, *u.evt);
+	return digest(hash);
+}
 
-				default: /* do nothing */;
-				}
-			}
+std::string linker::build_key() {
+	MD5 hash;
+	hash_string(hash, cache_version);
+	hash_string(hash, runtime_digest);
+	hash_signatures(hash, signatures);
 
-			std::ostringstream s;
-			s << obj.name << "_" << evt.main_id << "_" << evt.sub_id;
-			std::string c = code.str();
-			add_function(c.size(), c.c_str(), s.str(), 0, false);
-		}
+	hash_string(hash, optimizes_functions(config) ? "optimized" : "unoptimized");
+	hash_string(hash, std::to_string(config.profile));
+	std::vector<const profile_data::value_type*> counts;
+	for (const profile_data::value_type &entry : profile_counts) {
+		counts.push_back(&entry);
+	}
+	std::sort(counts.begin(), counts.end(), [](
+		const profile_data::value_type *a, const profile_data::value_type *b
+	) {
+		return a->first < b->first;
+	});
+	for (const profile_data::value_type *entry : counts) {
+		hash_string(hash, entry->first);
+		for (uint64_t n : entry->second) hash_string(hash, std::to_string(n));
 	}
+	return digest(hash);
 }
 
-std::ostream &operator <<(std::ostream &out, const argument &arg) {
-	switch (arg.kind) {
-	case argument::arg_expr:
-		return out << arg.val;
+std::unique_ptr<Module> linker::load_cached(const std::string &path) {
+	ErrorOr<std::unique_ptr<MemoryBuffer>> file = MemoryBuffer::getFile(path);
+	if (!file) return nullptr;
 
-	case argument::arg_both:
-		if (arg.val[0] == '"' || arg.val[0] == '\'') return out << arg.val;
+	// a bad cache entry is just a miss
+	ErrorOr<Module*> module = parseBitcodeFile(file.get()->getMemBufferRef(), context);
+	if (!module) return nullptr;
 
-	// fall through
-	case argument::arg_string: {
-		std::string val(arg.val);
-		while (val.find('"') != std::string::npos) {
-			val.replace(val.find('"'), 1, "\"+'\"'+\"");
+	return std::unique_ptr<Module>(module.get());
+}
+
+void linker::store_cached(const std::string &path, StringRef bitcode) {
+	std::error_code error;
+	tool_output_file out(path.c_str(), error, sys::fs::F_None);
+	if (error) return;
+
+	out.os() << bitcode;
+	out.keep();
+}
+
+static void write_json(raw_ostream &os, StringRef s) {
+	os << '"';
+	for (char c : s) {
+		if (c == '"' || c == '\\') os << '\\' << c;
+		else if ((unsigned char)c < 0x20) os << format("\\u%04x", (int)c);
+		else os << c;
+	}
+	os << '"';
+}
+
+// chrome's trace event format, with every phase as a complete event. like
+// the cache, a trace that can't be written doesn't fail the build
+void linker::write_trace() {
+	if (!config.trace) return;
+
+	std::string path = std::string(output) + "/trace.json";
+	std::error_code error;
+	tool_output_file out(path.c_str(), error, sys::fs::F_None);
+	if (error) return;
+
+	raw_ostream &os = out.os();
+	os << "{\"traceEvents\": [\n";
+	for (size_t i = 0; i < errors.timings.size(); i++) {
+		const phase_timing &t = errors.timings[i];
+		os << "{\"name\": ";
+		write_json(os, t.unit.empty() ? t.phase : t.phase + " " + t.unit);
+		os << ", \"cat\": ";
+		write_json(os, t.phase);
+		os	<< ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << t.thread
+			<< ", \"ts\": " << format("%.1f", t.start * 1e6)
+			<< ", \"dur\": " << format("%.1f", t.seconds * 1e6)
+			<< ", \"args\": {\"unit\": ";
+		write_json(os, t.unit);
+		os	<< ", \"bytes\": " << t.bytes
+			<< ", \"instructions\": " << t.instructions << "}}"
+			<< (i + 1 < errors.timings.size() ? ",\n" : "\n");
+	}
+	os << "]}\n";
+
+	out.keep();
+}
+
+// each unit gets its own module, either from the cache or freshly compiled.
+// the modules are linked in unit order so the output doesn't depend on the
+// cache or on scheduling
+void linker::compile(unsigned jobs) {
+	std::vector<const unit*> todo;
+	std::unordered_set<std::string> names;
+	for (const unit &u : units) {
+		if (!names.insert(u.name).second) {
+			errors.set_context(u.name);
+			errors.error(redefinition_error(u.name));
+			continue;
 		}
-		return out << '"' << val << '"';
+
+		todo.push_back(&u);
 	}
 
-	case argument::arg_bool:
-		return out << (arg.val[0] == '0');
+	std::ostringstream cache; cache << output << "/cache";
+	sys::fs::create_directories(cache.str());
 
-	case argument::arg_menu:
-		return out << arg.val;
+	std::string prefix = build_key();
+	std::vector<std::string> paths(todo.size());
+	std::vector<std::unique_ptr<Module>> modules(todo.size());
+	std::vector<size_t> misses;
+	{
+		phase_timer timer(errors, errors.started, "load cache");
+		for (size_t i = 0; i < todo.size(); i++) {
+			paths[i] = cache.str() + "/" + unit_key(prefix, *todo[i]) + ".bc";
+			modules[i] = load_cached(paths[i]);
+			if (!modules[i]) misses.push_back(i);
+		}
+	}
 
-	case argument::arg_color:
-		return out << '$' << arg.val;
+	if (jobs > 1 && misses.size() > 1) {
+		compile_parallel(jobs, todo, misses, paths, modules);
+	}
+	else {
+		for (size_t i : misses) {
+			compile_unit(compiler, errors, *todo[i]);
+			modules[i] = compiler.take_module();
+			if (errors.count() > 0) continue;
 
-	default:
-		return out << arg.resource;
+			std::string bitcode;
+			raw_string_ostream out(bitcode);
+			WriteBitcodeToFile(modules[i].get(), out);
+			store_cached(paths[i], out.str());
+		}
+	}
+
+	phase_timer timer(errors, errors.started, "link units");
+	objects = std::make_unique<Module>("objects", context);
+	Linker L(objects.get(), &diagnostic_handler);
+	for (size_t i = 0; i < modules.size(); i++) {
+		if (!modules[i]) continue;
+
+		if (L.linkInModule(modules[i].get())) {
+			errors.error("failed to link " + todo[i]->name);
+		}
+	}
+
+	// the only caller outside generated code, so the only one that needs the
+	// c signature whatever the script's own is
+	if (compiler.add_entry(entry_name, entry_script)) {
+		std::unique_ptr<Module> entry = compiler.take_module();
+		if (L.linkInModule(entry.get())) errors.error("failed to link entry");
 	}
 }
 
-void linker::add_function(
-	size_t length, const char *data,
-	const std::string &name, int args, bool var
+// each worker has its own context, runtime and code generator so LLVM needs
+// no locking. units come back as bitcode and are parsed into the main context
+void linker::compile_parallel(
+	unsigned jobs, const std::vector<const unit*> &todo,
+	const std::vector<size_t> &misses, const std::vector<std::string> &paths,
+	std::vector<std::unique_ptr<Module>> &modules
+) {
+	struct result {
+		error_buffer errors;
+		std::string bitcode;
+	};
+	std::vector<result> results(misses.size());
+	std::atomic<size_t> next(0);
+
+	auto work = [&](unsigned thread) {
+		LLVMContext context;
+		std::unique_ptr<Module> runtime(load_runtime(context));
+
+		error_buffer unit_errors;
+		node_codegen compiler(*runtime, unit_errors);
+		compiler.set_profile(config.profile, &profile_counts);
+		compiler.set_optimize(optimizes_functions(config));
+		for (auto &entry : signatures) {
+			compiler.register_script(entry.first, entry.second);
+		}
+
+		for (size_t i; (i = next++) < misses.size();) {
+			compile_unit(compiler, unit_errors, *todo[misses[i]], thread);
+			std::unique_ptr<Module> module = compiler.take_module();
+
+			if (unit_errors.count() == 0) {
+				raw_string_ostream out(results[i].bitcode);
+				WriteBitcodeToFile(module.get(), out);
+			}
+
+			results[i].errors = std::move(unit_errors);
+			unit_errors.clear();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < std::min<size_t>(jobs, misses.size()); i++) {
+		workers.emplace_back(work, i + 1);
+	}
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+
+	for (size_t i = 0; i < results.size(); i++) {
+		results[i].errors.replay(errors);
+		if (results[i].bitcode.empty()) continue;
+
+		size_t u = misses[i];
+		std::unique_ptr<MemoryBuffer> buffer = MemoryBuffer::getMemBuffer(
+			results[i].bitcode, todo[u]->name, false
+		);
+		ErrorOr<Module*> module = parseBitcodeFile(
+			buffer->getMemBufferRef(), context
+		);
+		if (std::error_code error = module.getError()) {
+			errors.error(error.message());
+			continue;
+		}
+
+		modules[u].reset(module.get());
+		store_cached(paths[u], results[i].bitcode);
+	}
+}
+
+void linker::compile_unit(
+	node_codegen &compiler, error_stream &e, const unit &u, unsigned thread
 ) {
-	buffer code(length, data);
+	buffer code(u.code.size(), u.code.c_str());
 	token_stream tokens(code);
 
 	arena allocator;
-	parser parser(tokens, allocator, errors);
-	errors.set_context(name);
+	e.set_context(u.name);
 
-	node *program = parser.getprogram();
-	if (errors.count() > 0) return;
+	// parsing and codegen are interleaved, so they're one phase
+	if (!u.evt && u.code.size() >= stream_size) {
+		phase_timer timer(e, errors.started, "stream", u.name, thread);
+		timer.instructions = count_instructions(
+			stream_unit(compiler, e, u, tokens, allocator)
+		);
+		return;
+	}
+
+	// lexing happens on demand, so it's part of parsing
+	node *program;
+	{
+		phase_timer timer(e, errors.started, "parse", u.name, thread);
+		if (u.evt) {
+			event_builder builder(*u.obj, *u.evt, allocator, e);
+			program = builder.getevent();
+		}
+		else {
+			parser parser(tokens, allocator, e);
+			program = parser.getprogram();
+		}
+		timer.bytes = allocator.bytes();
+	}
+	if (e.count() > 0) return;
+
+	{
+		phase_timer timer(e, errors.started, "fold", u.name, thread);
+		program = node_folder(allocator).fold(program);
+	}
+
+	phase_timer timer(e, errors.started, "codegen", u.name, thread);
+	timer.instructions = count_instructions(
+		compiler.add_function(program, u.name.c_str(), u.args, u.var)
+	);
+}
+
+// the function is finished even after an error, so the compiler is ready
+// for the next unit. the errors keep it out of the game
+Function *linker::stream_unit(
+	node_codegen &compiler, error_stream &e, const unit &u,
+	token_stream &tokens, arena &allocator
+) {
+	int errors_before = e.count();
+	Function *function = compiler.begin_function(u.name.c_str(), u.args, u.var);
+	if (!function) return nullptr;
+
+	parser parser(tokens, allocator, e);
+	node_folder folder(allocator);
+	while (statement *stmt = parser.getnext()) {
+		if (e.count() > errors_before) break;
+
+		compiler.add_statement(static_cast<statement*>(folder.fold(stmt)));
+		allocator.reset();
+	}
 
-	compiler.add_function(program, name.c_str(), args, var);
+	compiler.end_function();
+	return function;
 }
@@ -0,0 +1,172 @@
+#include <dejavu/linker/packed_game.h>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+	// any field past the end of the buffer reads as 0 and marks it bad, so
+	// decoding can check once at the end
+	struct reader {
+		reader(const char *p, const char *end) : p(p), end(end) {}
+
+		uint32_t u32() {
+			if (end - p < 4) return fail();
+
+			uint32_t v;
+			memcpy(&v, p, sizeof(v));
+			p += sizeof(v);
+			return v;
+		}
+
+		int32_t i32() { return u32(); }
+		bool flag() { return u32() != 0; }
+
+		// an enum or an index, which has to be below n
+		uint32_t below(uint32_t n) {
+			uint32_t v = u32();
+			if (v >= n) return fail();
+			return v;
+		}
+
+		char *str() {
+			size_t n = u32();
+			size_t padded = (n + 4) & ~size_t(3);
+			if (!ok || size_t(end - p) < padded || p[n] != '\0') {
+				fail();
+				return const_cast<char*>("");
+			}
+
+			char *s = const_cast<char*>(p);
+			p += padded;
+			return s;
+		}
+
+		int *ints(size_t n) {
+			if (size_t(end - p) / 4 < n) {
+				fail();
+				return 0;
+			}
+
+			int *v = reinterpret_cast<int*>(const_cast<char*>(p));
+			p += 4 * n;
+			return v;
+		}
+
+		// every element takes at least one field, so a count bigger than that
+		// is corrupt rather than a reason to allocate gigabytes
+		uint32_t count() {
+			uint32_t n = u32();
+			if (n > size_t(end - p) / 4) return fail();
+			return n;
+		}
+
+		uint32_t fail() {
+			ok = false;
+			p = end;
+			return 0;
+		}
+
+		const char *p, *end;
+		bool ok = true;
+	};
+}
+
+packed_game::packed_game(const char *data, size_t size) : source(), ok(false) {
+	// argument types are read in place
+	if (reinterpret_cast<uintptr_t>(data) % alignof(int) != 0) return;
+
+	reader in(data, data + size);
+	source.version = in.i32();
+	source.name = in.str();
+
+	action_types.resize(in.count());
+	for (action_type &type : action_types) {
+		type.id = in.i32();
+		type.parent = in.i32();
+		type.kind = static_cast<decltype(type.kind)>(
+			in.below(action_type::act_label + 1)
+		);
+		type.question = in.flag();
+		type.relative = in.flag();
+		type.exec = static_cast<decltype(type.exec)>(
+			in.below(action_type::exec_code + 1)
+		);
+		type.code = in.str();
+		type.nargs = in.count();
+		type.args = in.ints(type.nargs);
+	}
+
+	scripts.resize(in.count());
+	for (script &scr : scripts) {
+		scr.id = in.u32();
+		scr.name = in.str();
+		scr.code = in.str();
+	}
+
+	// events, actions and arguments go in one array each, and the owners only
+	// get pointers into them once they've stopped growing
+	std::vector<size_t> first_event, first_action, first_argument;
+
+	objects.resize(in.count());
+	for (object &obj : objects) {
+		obj.id = in.u32();
+		obj.name = in.str();
+		obj.sprite = in.i32();
+		obj.mask = in.i32();
+		obj.parent = in.i32();
+		obj.solid = in.flag();
+		obj.visible = in.flag();
+		obj.persistent = in.flag();
+		obj.depth = in.i32();
+
+		obj.nevents = in.count();
+		first_event.push_back(events.size());
+		for (unsigned e = 0; e < obj.nevents && in.ok; e++) {
+			events.emplace_back();
+			event &evt = events.back();
+			evt.main_id = in.u32();
+			evt.sub_id = in.u32();
+
+			evt.nactions = in.count();
+			first_action.push_back(actions.size());
+			for (unsigned a = 0; a < evt.nactions && in.ok; a++) {
+				actions.emplace_back();
+				action &act = actions.back();
+
+				uint32_t type = in.below(action_types.size());
+				act.type = in.ok ? &action_types[type] : 0;
+				act.relative = in.flag();
+				act.inv = in.flag();
+				act.target = in.i32();
+
+				act.nargs = in.count();
+				first_argument.push_back(arguments.size());
+				for (unsigned n = 0; n < act.nargs && in.ok; n++) {
+					arguments.emplace_back();
+					argument &arg = arguments.back();
+					arg.kind = static_cast<decltype(arg.kind)>(
+						in.below(argument::arg_fontstr + 1)
+					);
+					arg.val = in.str();
+					arg.resource = in.u32();
+				}
+			}
+		}
+	}
+
+	if (!in.ok) return;
+
+	for (size_t i = 0; i < objects.size(); i++)
+		objects[i].events = events.data() + first_event[i];
+	for (size_t i = 0; i < events.size(); i++)
+		events[i].actions = actions.data() + first_action[i];
+	for (size_t i = 0; i < actions.size(); i++)
+		actions[i].args = arguments.data() + first_argument[i];
+
+	source.nactions = action_types.size();
+	source.actions = action_types.data();
+	source.nscripts = scripts.size();
+	source.scripts = scripts.data();
+	source.nobjects = objects.size();
+	source.objects = objects.data();
+	ok = true;
+}
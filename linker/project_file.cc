@@ -0,0 +1,23 @@
+#include <dejavu/linker/project_file.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+static const char magic[4] = { 'd', 'j', 'v', 'p' };
+static const uint32_t format_version = 1;
+
+// the header is 8 bytes, which keeps the packed game 4-byte aligned
+int project_file::open_file(const char *path) {
+	if (int error = file.open_file(path)) return error;
+
+	const char *data = file.begin();
+	size_t size = file.end() - file.begin();
+	if (size < 8 || memcmp(data, magic, sizeof(magic)) != 0) return EINVAL;
+
+	uint32_t version;
+	memcpy(&version, data + 4, sizeof(version));
+	if (version != format_version) return EINVAL;
+
+	packed.reset(new packed_game(data + 8, size - 8));
+	return packed->valid() ? 0 : EINVAL;
+}
@@ -2,33 +2,41 @@
 
 %{
 #include "dejavu/linker/game.h"
+#include "dejavu/linker/packed_game.h"
+#include "dejavu/linker/build_config.h"
 #include "driver.h"
 %}
 
 %feature("director") build_log;
 
-%include "carrays.i"
-
-%define %array_move(type, array)
-%typemap(javacode) array %{
-	public type move() {
-		swigCMemOwn = false;
-		return cast();
+%include "std_string.i"
+
+// Writer.pack() hands over the whole game as one direct buffer, which the
+// game then points into. the proxy keeps the buffer alive for it
+%typemap(jni) (const char *data, size_t size) "jobject"
+%typemap(jtype) (const char *data, size_t size) "java.nio.ByteBuffer"
+%typemap(jstype) (const char *data, size_t size) "java.nio.ByteBuffer"
+%typemap(javain, post="      buffer = $javainput;") (const char *data, size_t size) "$javainput"
+%typemap(in) (const char *data, size_t size) {
+	$1 = static_cast<const char*>(jenv->GetDirectBufferAddress($input));
+	$2 = static_cast<size_t>(jenv->GetDirectBufferCapacity($input));
+	if (!$1) {
+		SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException, "expected a direct buffer");
+		return $null;
 	}
+}
+%typemap(javacode) packed_game %{
+	private java.nio.ByteBuffer buffer;
 %}
 
-%array_class(type, array);
-%enddef
+%include "dejavu/linker/game.h"
+%include "dejavu/linker/packed_game.h"
 
-%array_move(script, scriptArray);
-%array_move(object, objectArray);
-%array_move(event, eventArray);
-%array_move(action_type, actionTypeArray);
-%array_move(action, actionArray);
-%array_class(int, argumentTypeArray);
-%array_move(argument, argArray);
+// java only picks the mode- reading profiles back is the linker's job
+%ignore read_profile;
+%include "dejavu/compiler/profile.h"
+%include "dejavu/linker/build_config.h"
 
-%include "dejavu/linker/game.h"
 %include "driver.h"
 
 %pragma(java) jniclassimports="import java.io.File;"
@@ -6,6 +6,11 @@
 #include <llvm/Support/Host.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/ManagedStatic.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
 
 #include <cstdio>
 #include <sstream>
@@ -55,6 +60,13 @@ public:
 		if (!n.empty()) log.message(n.c_str());
 	}
 
+	void timing(const phase_timing &t) {
+		log.timing(
+			t.phase.c_str(), t.unit.c_str(), t.start, t.seconds,
+			t.bytes, t.instructions, t.thread
+		);
+	}
+
 private:
 	build_log &log;
 	int errors = 0;
@@ -64,20 +76,99 @@ private:
 
 llvm::llvm_shutdown_obj y;
 
-// todo: replace debug with configuration struct
-bool compile(
+session::session() : context(new llvm::LLVMContext), builds(0) {
+	llvm::InitializeNativeTarget();
+	llvm::InitializeNativeTargetAsmPrinter();
+
+	runtime = load_runtime(*context);
+}
+
+// the runtime has to go before the context that owns its types
+session::~session() {
+	for (auto &m : machines) delete m.second;
+	delete runtime;
+	delete context;
+}
+
+void session::reset_context() {
+	delete runtime;
+	delete context;
+
+	context = new llvm::LLVMContext;
+	runtime = load_runtime(*context);
+	builds = 0;
+}
+
+static std::string host_features() {
+	llvm::StringMap<bool> features;
+	if (!llvm::sys::getHostCPUFeatures(features)) return "";
+
+	std::string result;
+	for (auto &f : features) {
+		if (!result.empty()) result += ",";
+		result += (f.getValue() ? "+" : "-") + f.getKey().str();
+	}
+	return result;
+}
+
+llvm::TargetMachine *session::get_machine(const build_config &config) {
+	std::string cpu = config.cpu, features = config.features;
+	if (cpu == "native") {
+		cpu = llvm::sys::getHostCPUName();
+		if (features.empty()) features = host_features();
+	}
+
+	llvm::CodeGenOpt::Level level;
+	switch (config.opt) {
+	case opt_o0: level = llvm::CodeGenOpt::None; break;
+	case opt_o1: level = llvm::CodeGenOpt::Less; break;
+	case opt_o2: case opt_os: level = llvm::CodeGenOpt::Default; break;
+	case opt_o3: level = llvm::CodeGenOpt::Aggressive; break;
+	}
+
+	std::ostringstream key;
+	key << cpu << ";" << features << ";" << level;
+	llvm::TargetMachine *&machine = machines[key.str()];
+	if (machine) return machine;
+
+	std::string triple = llvm::sys::getDefaultTargetTriple();
+	const llvm::Target *t = llvm::TargetRegistry::lookupTarget(triple, machine_error);
+	if (t) machine = t->createTargetMachine(
+		triple, cpu, features, llvm::TargetOptions(),
+		llvm::Reloc::PIC_, llvm::CodeModel::Default, level
+	);
+	return machine;
+}
+
+bool session::compile(
 	const char *output, const char *target,
-	game &source, build_log &log, bool debug
+	game &source, build_log &log, const build_config &config
 ) {
-	error_printer errors(log);
+	return build(output, target, source, log, config, false);
+}
 
-	llvm::InitializeNativeTarget();
+bool session::run(
+	const char *output, game &source, build_log &log,
+	const build_config &config
+) {
+	return build(output, "game", source, log, config, true);
+}
 
-	// we need a new context for every compilation or LLVM chokes on types
-	llvm::LLVMContext context;
+bool session::build(
+	const char *output, const char *target,
+	game &source, build_log &log, const build_config &config, bool jit
+) {
+	if (builds == builds_per_context) reset_context();
+	builds++;
+
+	error_printer errors(log);
+	llvm::TargetMachine *machine = get_machine(config);
+	if (!machine) {
+		errors.error(machine_error);
+		return false;
+	}
 
-	return linker(
-		output, source, errors,
-		llvm::sys::getDefaultTargetTriple(), context
-	).build(target, debug);
+	return linker(output, source, errors, *runtime, *machine).build(
+		target, config, jit ? emit_jit : emit_executable
+	);
 }
@@ -1,8 +1,19 @@
 #ifndef DRIVER_H
 #define DRIVER_H
 
+#include <dejavu/linker/build_config.h>
+#include <cstddef>
+#include <string>
+#include <map>
+
 struct game;
 
+namespace llvm {
+	class LLVMContext;
+	class Module;
+	class TargetMachine;
+}
+
 // impure-virtual to appease Java
 struct build_log {
 	virtual ~build_log() {}
@@ -10,13 +21,58 @@ struct build_log {
 	virtual void message(const char*) {}
 	virtual void percent(int) {}
 
+	// a phase of the build finished. see phase_timing
+	virtual void timing(
+		const char *phase, const char *unit, double start, double seconds,
+		size_t bytes, size_t instructions, unsigned thread
+	) {}
+
 protected:
 	build_log() {}
 };
 
-bool compile(
-	const char *output, const char *target,
-	game &source, build_log &log, bool debug
-);
+// keeps LLVM warm between builds- the context, the parsed runtime and the
+// target machine are set up once and reused by every compile. a context never
+// frees the types, constants and metadata its modules leave behind, so it's
+// replaced, along with the runtime, every builds_per_context builds
+class session {
+public:
+	session();
+	~session();
+
+	bool compile(
+		const char *output, const char *target,
+		game &source, build_log &log, const build_config &config
+	);
+
+	// builds the game and runs it in this process, returning when it exits
+	bool run(
+		const char *output, game &source, build_log &log,
+		const build_config &config
+	);
+
+private:
+	bool build(
+		const char *output, const char *target,
+		game &source, build_log &log, const build_config &config, bool jit
+	);
+
+	// one per cpu, features and opt level, created the first time a build
+	// asks for it
+	llvm::TargetMachine *get_machine(const build_config &config);
+
+	// machines don't belong to a context, so they're kept
+	void reset_context();
+	static const unsigned builds_per_context = 8;
+
+	session(const session&);
+	session &operator=(const session&);
+
+	llvm::LLVMContext *context;
+	llvm::Module *runtime;
+	unsigned builds;
+	std::map<std::string, llvm::TargetMachine*> machines;
+	std::string machine_error;
+};
 
 #endif
@@ -13,11 +13,14 @@ import java.nio.file.Files;
 import java.util.*;
 
 public class Runner implements ActionListener, LGM.ReloadListener {
-	private JMenuItem compileItem, runItem, debugItem;
+	private JMenuItem compileItem, runItem, debugItem, exportItem;
 	private JButton compileButton, runButton, debugButton;
 
 	private ProgressPane progress;
 
+	// kept for the life of the plugin so builds after the first start warm
+	private final session backend = new session();
+
 	public Runner() {
 		LGM.mdi.setBackground(Color.LIGHT_GRAY);
 
@@ -46,6 +49,10 @@ public class Runner implements ActionListener, LGM.ReloadListener {
 		debugItem.setAccelerator(KeyStroke.getKeyStroke(117, 0));
 		runMenu.add(debugItem);
 
+		runMenu.addSeparator();
+		exportItem = createMenuItem("Toolbar.EXPORT", "Export Project");
+		runMenu.add(exportItem);
+
 		LGM.frame.getJMenuBar().add(runMenu, 3);
 
 		// buttons
@@ -103,22 +110,46 @@ public class Runner implements ActionListener, LGM.ReloadListener {
 		return new ImageIcon(url);
 	}
 
-	private synchronized boolean build(File output, File target, boolean debug) {
+	// the build cache lives in the output directory, so saved projects keep
+	// theirs between builds
+	private static File getOutputDirectory() throws IOException {
+		if (LGM.currentFile.uri == null) {
+			return Files.createTempDirectory("djv").toFile();
+		}
+
+		String name = Integer.toHexString(LGM.currentFile.uri.toString().hashCode());
+		File output = new File(System.getProperty("java.io.tmpdir"), "djv-" + name);
+		if (!output.isDirectory() && !output.mkdirs()) {
+			throw new IOException("unable to create " + output.getPath());
+		}
+		return output;
+	}
+
+	// a null target runs the game in-process instead of writing an executable
+	private synchronized boolean build(File output, File target, build_config config) {
 		progress.reset();
 		progress.message("writing game data");
 		LGM.commitAll();
-		game source = new Writer(LGM.currentFile, progress).write();
+		packed_game packed = new packed_game(new Writer(LGM.currentFile, progress).pack());
+		if (!packed.valid()) {
+			progress.append("unable to read the packed game\n");
+			progress.message("failed");
+			packed.delete();
+			return false;
+		}
+		game source = packed.get();
 
 		progress.percent(10);
 		progress.message("building game");
 		progress.append(
 			"building " + source.getName() + " (" + source.getVersion() + ")" +
-			" to " + target.getPath() + "\n"
-		);
-		boolean success = dejavu.compile(
-			output.getPath(), target.getPath(),
-			source, progress.new Log(), debug
+			(target != null ? " to " + target.getPath() : "") + "\n"
 		);
+		boolean success = target != null ?
+			backend.compile(output.getPath(), target.getPath(), source, progress.new Log(), config) :
+			backend.run(output.getPath(), source, progress.new Log(), config);
+
+		packed.delete();
 
 		if (success) {
 			progress.percent(100);
@@ -142,10 +173,9 @@ public class Runner implements ActionListener, LGM.ReloadListener {
 		File file = save.getSelectedFile();
 		if (!file.getName().endsWith(ext)) file = new File(file.getPath() + ext);
 
-		// todo: factor this out and do it per-project
 		final File output;
 		try {
-			output = Files.createTempDirectory("djv").toFile();
+			output = getOutputDirectory();
 		}
 		catch (IOException e) {
 			e.printStackTrace();
@@ -154,34 +184,35 @@ public class Runner implements ActionListener, LGM.ReloadListener {
 
 		final File target = file;
 		new Thread() { public void run() {
-			build(output, target, false);
+			build(output, target, new build_config());
 		} }.start();
 	}
 
 	private void run() {
 		final File output;
 		try {
-			output = Files.createTempDirectory("djv").toFile();
+			output = getOutputDirectory();
 		}
 		catch (IOException e) {
 			e.printStackTrace();
 			return;
 		}
 
-		final File target = new File(
-			output.getPath() + File.separatorChar + "game"
-		);
+		// run straight from the jit- designers care about time to first frame,
+		// so only do the cheap optimizations
+		final build_config config = new build_config();
+		config.setOpt(opt_level.opt_o1);
+		config.setLto(false);
 
 		new Thread() { public void run() {
-			boolean success = build(output, target, false);
-			if (success) progress.append("run " + target.getPath() + "\n");
+			build(output, null, config);
 		} }.start();
 	}
 
 	private void debug() {
 		final File output;
 		try {
-			output = Files.createTempDirectory("djv").toFile();
+			output = getOutputDirectory();
 		}
 		catch (IOException e) {
 			e.printStackTrace();
@@ -192,18 +223,44 @@ public class Runner implements ActionListener, LGM.ReloadListener {
 			output.getPath() + File.separatorChar + "game"
 		);
 
+		final build_config config = new build_config();
+		config.setOpt(opt_level.opt_o0);
+		config.setOptimize_functions(false);
+		config.setLto(false);
+
 		new Thread() { public void run() {
-			boolean success = build(output, target, true);
+			boolean success = build(output, target, config);
 			if (success) progress.append("debug " + target.getPath() + "\n");
 		} }.start();
 	}
 
+	// for building from the command line, without lateralgm or java
+	private void export() {
+		JFileChooser save = new JFileChooser();
+		save.setFileFilter(new CustomFileFilter(".djv", "Dejavu projects"));
+		if (save.showSaveDialog(LGM.frame) != JFileChooser.APPROVE_OPTION) return;
+
+		File file = save.getSelectedFile();
+		if (!file.getName().endsWith(".djv")) file = new File(file.getPath() + ".djv");
+
+		progress.reset();
+		LGM.commitAll();
+		try {
+			new Writer(LGM.currentFile, progress).save(file);
+			progress.append("exported " + file.getPath() + "\n");
+		}
+		catch (IOException e) {
+			progress.append("unable to write " + file.getPath() + ": " + e.getMessage() + "\n");
+		}
+	}
+
 	@Override
 	public void actionPerformed(ActionEvent event) {
 		Object source = event.getSource();
 		if (source == compileItem || source == compileButton) compile();
 		if (source == runItem || source == runButton) run();
 		if (source == debugItem || source == debugButton) debug();
+		if (source == exportItem) export();
 	}
 
 	@Override
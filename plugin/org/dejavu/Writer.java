@@ -1,6 +1,5 @@
 package org.dejavu;
 
-import org.dejavu.backend.*;
 import org.lateralgm.main.LGM;
 import org.lateralgm.file.*;
 import org.lateralgm.resources.*;
@@ -8,184 +7,171 @@ import org.lateralgm.resources.GmObject.*;
 import org.lateralgm.resources.sub.*;
 import org.lateralgm.resources.library.*;
 import static org.lateralgm.main.Util.deRef;
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.channels.FileChannel;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
 import java.util.List;
 import java.util.HashMap;
 
+// packs the whole game into one direct buffer in the layout packed_game reads,
+// so handing it to the compiler is a single crossing instead of one per field
 public class Writer {
 	private GmFile file;
-	private game out;
 	private ProgressPane log;
+	private ByteBuffer out;
 
 	public Writer(GmFile f, ProgressPane l) {
 		file = f;
-		out = new game();
 		log = l;
 	}
 
-	// todo: use JNI directly to avoid all this excessive copying
-	public game write() {
-		out.setVersion(file.format != null ? file.format.getVersion() : -1);
-		out.setName(file.uri != null ? file.uri.toString() : "<untitled>");
+	public ByteBuffer pack() {
+		out = ByteBuffer.allocateDirect(1 << 16).order(ByteOrder.nativeOrder());
+
+		putInt(file.format != null ? file.format.getVersion() : -1);
+		putString(file.uri != null ? file.uri.toString() : "<untitled>");
 
 		writeLibraries();
 
 		writeScripts();
 		writeObjects();
 
-		return out;
+		ByteBuffer packed = out;
+		out = null;
+		return packed;
 	}
 
-	// todo: do this on-demand, eventually keep libs compiled on installation
-	private HashMap<LibAction, action_type> actionTypes = new HashMap<LibAction, action_type>();
+	// the layout project_file reads: "djvp", the format version, then the
+	// packed game. the compiler maps the file and uses the game in place
+	public void save(File target) throws IOException {
+		ByteBuffer packed = pack();
+		packed.flip();
+
+		ByteBuffer header = ByteBuffer.allocate(8).order(ByteOrder.nativeOrder());
+		header.put("djvp".getBytes(StandardCharsets.US_ASCII));
+		header.putInt(1);
+		header.flip();
+
+		try (FileChannel channel = new FileOutputStream(target).getChannel()) {
+			channel.write(new ByteBuffer[] { header, packed });
+		}
+	}
+
+	// the compiler keeps the libraries' code compiled, but still needs their
+	// action types to build events. actions refer to them by index
+	// todo: do this on-demand
+	private HashMap<LibAction, Integer> actionTypes = new HashMap<LibAction, Integer>();
 	private void writeLibraries() {
 		int actionCount = 0;
 		for (Library lib : LibManager.libs) {
 			actionCount += lib.libActions.size();
 		}
 
-		actionTypeArray actionsOut = new actionTypeArray(actionCount);
-		int i = 0;
+		putInt(actionCount);
 		for (Library lib : LibManager.libs) {
 			for (LibAction act : lib.libActions) {
-				action_type a = new action_type();
-				a.setId(act.id);
-				a.setParent(act.parentId);
-				a.setKind(act.actionKind);
-				a.setQuestion(act.question);
-				a.setRelative(act.allowRelative);
-				a.setExec(act.execType);
-				a.setCode(act.execInfo);
-
-				argumentTypeArray argsOut = new argumentTypeArray(
-					act.libArguments.length
-				);
-				int j = 0;
+				actionTypes.put(act, actionTypes.size());
+
+				putInt(act.id);
+				putInt(act.parentId);
+				putInt(act.actionKind);
+				putBoolean(act.question);
+				putBoolean(act.allowRelative);
+				putInt(act.execType);
+				putString(act.execInfo);
+
+				putInt(act.libArguments.length);
 				for (LibArgument arg : act.libArguments) {
-					argsOut.setitem(j, arg.kind);
-					j++;
+					putInt(arg.kind);
 				}
-				a.setNargs(act.libArguments.length);
-				a.setArgs(argsOut.cast());
-
-				actionsOut.setitem(i, a);
-				actionTypes.put(act, a);
-				i++;
 			}
 		}
-		out.setNactions(actionCount);
-		out.setActions(actionsOut.move());
 	}
 
 	private void writeScripts() {
 		ResourceList<Script> scripts = file.resMap.getList(Script.class);
-		scriptArray scriptsOut = new scriptArray(scripts.size());
-		int i = 0;
+		putInt(scripts.size());
 
 		for (Script scr : scripts) {
-			script s = new script();
-			s.setId(scr.getId());
-			s.setName(scr.getName());
-			s.setCode(scr.getCode());
-
-			scriptsOut.setitem(i, s);
-			i++;
+			putInt(scr.getId());
+			putString(scr.getName());
+			putString(scr.getCode());
 		}
-
-		out.setNscripts(scripts.size());
-		out.setScripts(scriptsOut.move());
 	}
 
 	private void writeObjects() {
 		ResourceList<GmObject> objects = file.resMap.getList(GmObject.class);
-		objectArray objectsOut = new objectArray(objects.size());
-		int i = 0;
-		for (GmObject obj : objects) {
-			object o = new object();
-			o.setId(obj.getId());
-			o.setName(obj.getName());
+		putInt(objects.size());
 
-			o.setSprite(toId(obj.get(PGmObject.SPRITE), -1));
-			o.setMask(toId(obj.get(PGmObject.MASK), -1));
-			o.setParent(toId(obj.get(PGmObject.PARENT), -100));
+		for (GmObject obj : objects) {
+			putInt(obj.getId());
+			putString(obj.getName());
 
-			o.setSolid((Boolean)obj.get(PGmObject.SOLID));
-			o.setVisible((Boolean)obj.get(PGmObject.VISIBLE));
-			o.setPersistent((Boolean)obj.get(PGmObject.PERSISTENT));
+			putInt(toId(obj.get(PGmObject.SPRITE), -1));
+			putInt(toId(obj.get(PGmObject.MASK), -1));
+			putInt(toId(obj.get(PGmObject.PARENT), -100));
 
-			o.setDepth((Integer)obj.get(PGmObject.DEPTH));
+			putBoolean((Boolean)obj.get(PGmObject.SOLID));
+			putBoolean((Boolean)obj.get(PGmObject.VISIBLE));
+			putBoolean((Boolean)obj.get(PGmObject.PERSISTENT));
 
-			writeEvents(obj, o);
+			putInt((Integer)obj.get(PGmObject.DEPTH));
 
-			objectsOut.setitem(i, o);
-			i++;
+			writeEvents(obj);
 		}
-		out.setNobjects(objects.size());
-		out.setObjects(objectsOut.move());
 	}
 
-	private void writeEvents(GmObject obj, object out) {
+	private void writeEvents(GmObject obj) {
 		int eventCount = 0;
 		for (MainEvent me : obj.mainEvents) {
 			eventCount += me.events.size();
 		}
 
-		eventArray eventsOut = new eventArray(eventCount);
-		int i = 0;
+		putInt(eventCount);
 		for (int mid = 0; mid < obj.mainEvents.size(); mid++) {
 			for (Event evt : obj.mainEvents.get(mid).events) {
-				event e = new event();
-				e.setMain_id(mid);
-				e.setSub_id(mid == MainEvent.EV_COLLISION ? toId(evt.other, -1) : evt.id);
-
-				writeActions(evt, e);
+				putInt(mid);
+				putInt(mid == MainEvent.EV_COLLISION ? toId(evt.other, -1) : evt.id);
 
-				eventsOut.setitem(i, e);
-				i++;
+				writeActions(evt);
 			}
 		}
-		out.setNevents(eventCount);
-		out.setEvents(eventsOut.move());
 	}
 
-	private void writeActions(Event evt, event out) {
-		actionArray actionsOut = new actionArray(evt.actions.size());
-		int i = 0;
+	// unsupported actions are left out of the count as well as the buffer
+	private void writeActions(Event evt) {
+		List<Action> actions = new ArrayList<Action>();
 		for (Action act : evt.actions) {
-			LibAction type = act.getLibAction();
-			if (type == null) {
+			if (!actionTypes.containsKey(act.getLibAction())) {
 				log.append("unsupported action: " + act.toString() + "\n");
 				continue;
 			}
+			actions.add(act);
+		}
 
-			action a = new action();
-			a.setType(actionTypes.get(type));
-			a.setRelative(act.isRelative());
-			a.setInv(act.isNot());
-			a.setTarget(GmObject.refAsInt(act.getAppliesTo()));
-
-			writeArguments(act, a);
+		putInt(actions.size());
+		for (Action act : actions) {
+			putInt(actionTypes.get(act.getLibAction()));
+			putBoolean(act.isRelative());
+			putBoolean(act.isNot());
+			putInt(GmObject.refAsInt(act.getAppliesTo()));
 
-			actionsOut.setitem(i, a);
-			i++;
+			writeArguments(act);
 		}
-		out.setNactions(evt.actions.size());
-		out.setActions(actionsOut.move());
 	}
 
-	private void writeArguments(Action act, action out) {
-		argArray argsOut = new argArray(act.getArguments().size());
-		int i = 0;
+	private void writeArguments(Action act) {
+		putInt(act.getArguments().size());
 		for (Argument arg : act.getArguments()) {
-			argument a = new argument();
-			a.setKind(arg.kind);
-			a.setVal(arg.getVal());
-			a.setResource(toId(arg.getRes(), -1));
-
-			argsOut.setitem(i, a);
-			i++;
+			putInt(arg.kind);
+			putString(arg.getVal());
+			putInt(toId(arg.getRes(), -1));
 		}
-		out.setNargs(act.getArguments().size());
-		out.setArgs(argsOut.move());
 	}
 
 	private static int toId(Object obj, int def) {
@@ -193,4 +179,38 @@ public class Writer {
 		if (res != null) return ((InstantiableResource<?, ?>)res).getId();
 		return def;
 	}
+
+	// direct buffers can't grow, so this copies into one twice the size
+	private void reserve(int size) {
+		if (out.remaining() >= size) return;
+
+		int capacity = out.capacity();
+		while (capacity - out.position() < size) capacity *= 2;
+
+		ByteBuffer bigger = ByteBuffer.allocateDirect(capacity).order(ByteOrder.nativeOrder());
+		out.flip();
+		bigger.put(out);
+		out = bigger;
+	}
+
+	private void putInt(int value) {
+		reserve(4);
+		out.putInt(value);
+	}
+
+	private void putBoolean(boolean value) {
+		putInt(value ? 1 : 0);
+	}
+
+	// the length, the bytes, a nul for the compiler's sake, then zeros up to
+	// the next field
+	private void putString(String value) {
+		byte[] bytes = (value != null ? value : "").getBytes(StandardCharsets.UTF_8);
+		int padded = (bytes.length + 4) & ~3;
+		reserve(4 + padded);
+
+		out.putInt(bytes.length);
+		out.put(bytes);
+		for (int i = bytes.length; i < padded; i++) out.put((byte)0);
+	}
 }
@@ -1,12 +1,17 @@
 #include <dejavu/runtime/variant.h>
 #include <dejavu/runtime/scope.h>
+#include <dejavu/runtime/instance.h>
+#include <dejavu/runtime/profile.h>
 
-extern "C" variant scr_0(scope *self, scope *other, short, variant args[]);
+// scr_0, through the c signature the linker wraps it in
+extern "C" variant game_entry(scope *self, scope *other, short, variant args[]);
 
-string_pool strings;
+// generated code interns its literals from global constructors
+__attribute__((init_priority(101))) string_pool strings;
+__attribute__((init_priority(101))) arena frame;
 
 int main(int argc, char *argv[]) {
-	variant *args = new variant[argc];
+	variant *args = new (frame) variant[argc];
 	for (int i = 0; i < argc; i++) {
 		args[i].type = 1;
 
@@ -19,14 +24,21 @@ int main(int argc, char *argv[]) {
 	scope self, other;
 	variant *foo = new variant[1];
 	foo[0] = strings.intern("foo");
-	self[foo->string] = var{1, 1, foo};
+	self[foo->string] = var{1, 1, 1, 1, foo};
 
-	scr_0(&self, &other, argc, args);
+	// the pool sweeps a long batch as it goes, so this one stays bounded.
+	// todo: open a batch and flush instances per event once there's an event
+	// loop
+	strings.begin_batch();
+	game_entry(&self, &other, argc, args);
+	flush_instances();
+	strings.end_batch();
 
 	for (int i = 0; i < argc; i++) {
 		args[i].string->release();
 	}
-	delete[] args;
+	frame.reset();
 
+	profile_dump();
 	return 0;
 }
@@ -0,0 +1,197 @@
+#include <dejavu/runtime/instance.h>
+#include <dejavu/runtime/error.h>
+
+// instance ids start here, like in gm, so they never collide with objects
+static const double first_id = 100001;
+
+// built on first use from object_parents, like the slot table
+static std::vector<object_pool> &pools() {
+	static std::vector<object_pool> pools(object_count);
+	static bool built = false;
+	if (!built) {
+		// the linker checks parents, but a cycle would still never end
+		for (unsigned i = 0; i < object_count; i++) {
+			int p = i;
+			for (unsigned n = 0; p >= 0 && n < object_count; n++) {
+				pools[p].descendants.push_back(i);
+				p = object_parents[p];
+			}
+		}
+		built = true;
+	}
+	return pools;
+}
+
+// every object in order, for with (all)
+static std::vector<unsigned> &all_objects() {
+	static std::vector<unsigned> all;
+	if (all.empty()) {
+		for (unsigned i = 0; i < object_count; i++) all.push_back(i);
+	}
+	return all;
+}
+
+// indexed by id - first_id. null once the instance is destroyed
+static std::vector<instance*> instance_ids;
+static table<scope*, instance*> instance_scopes;
+
+// removed from their pools by flush_instances
+static std::vector<instance*> destroyed;
+
+instance *find_instance(double id) {
+	if (id >= first_id) {
+		size_t n = id - first_id;
+		instance *i = n < instance_ids.size() ? instance_ids[n] : 0;
+		return i && !i->dead ? i : 0;
+	}
+
+	if (id >= 0 && id < object_count) {
+		for (unsigned object : pools()[(unsigned)id].descendants) {
+			for (instance *i : pools()[object].instances) {
+				if (!i->dead) return i;
+			}
+		}
+	}
+
+	return 0;
+}
+
+instance *as_instance(scope *s) {
+	table<scope*, instance*>::node *n = instance_scopes.find(s);
+	return n != instance_scopes.end() ? n->v : 0;
+}
+
+static void set_real(scope &s, const char *name, double value) {
+	var &v = s[strings.intern(name)];
+	*access_var(&v, 0, 0, true) = value;
+}
+
+// new instances join the end of their pool straight away, so the rest of
+// the step can find and count them. with_inc indexes the pool rather than
+// holding on to it, so the append can't pull it out from under a with
+static instance *create_instance(unsigned object, double x, double y) {
+	instance *i = new instance(first_id + instance_ids.size(), object);
+	instance_ids.push_back(i);
+	instance_scopes[i] = i;
+
+	object_pool &pool = pools()[object];
+	i->index = pool.instances.size();
+	pool.instances.push_back(i);
+	pool.live++;
+
+	set_real(*i, "x", x);
+	set_real(*i, "y", y);
+	return i;
+}
+
+// the scope stays valid until the flush, since something up the stack may
+// still be running in it
+static void destroy_instance(instance *i) {
+	if (i->dead) return;
+
+	i->dead = true;
+	destroyed.push_back(i);
+	scope_epoch++;
+
+	pools()[i->object].live--;
+}
+
+void flush_instances() {
+	// the last instance in the pool takes this one's place
+	for (instance *i : destroyed) {
+		object_pool &pool = pools()[i->object];
+		pool.instances[i->index] = pool.instances.back();
+		pool.instances[i->index]->index = i->index;
+		pool.instances.pop_back();
+
+		instance_ids[(size_t)(i->id - first_id)] = 0;
+		instance_scopes.remove(i);
+		i->release_vars();
+		delete i;
+	}
+	destroyed.clear();
+}
+
+extern "C" scope *with_begin(
+	with_iterator *it, scope *self, scope *other, variant *target
+) {
+	it->object = it->end = 0;
+	it->index = 0;
+	it->limit = first_id + instance_ids.size();
+
+	double id = to_real(*target);
+	switch ((int)id) {
+	case -1: return self;
+	case -2: return other;
+	case -4: return 0;
+
+	case -3: {
+		std::vector<unsigned> &all = all_objects();
+		it->object = all.data();
+		it->end = all.data() + all.size();
+		return with_inc(it);
+	}
+	}
+
+	if (id >= 0 && id < object_count) {
+		std::vector<unsigned> &objects = pools()[(unsigned)id].descendants;
+		it->object = objects.data();
+		it->end = objects.data() + objects.size();
+		return with_inc(it);
+	}
+
+	return find_instance(id);
+}
+
+extern "C" scope *with_inc(with_iterator *it) {
+	while (it->object != it->end) {
+		object_pool &pool = pools()[*it->object];
+		while (it->index < pool.instances.size()) {
+			instance *i = pool.instances[it->index++];
+			if (!i->dead && i->id < it->limit) return i;
+		}
+
+		it->object++;
+		it->index = 0;
+	}
+
+	return 0;
+}
+
+extern "C" variant instance_create(
+	scope *self, scope *other,
+	const variant &x, const variant &y, const variant &obj
+) {
+	double object = to_real(obj);
+	if (!(object >= 0 && object < object_count)) {
+		show_error(self, other, "object does not exist", true);
+		return 0.0;
+	}
+
+	return create_instance(object, to_real(x), to_real(y))->id;
+}
+
+extern "C" variant instance_destroy(scope *self, scope *other) {
+	instance *i = as_instance(self);
+	if (i) destroy_instance(i);
+	return 0.0;
+}
+
+extern "C" variant instance_exists(
+	scope *self, scope *other, const variant &obj
+) {
+	return find_instance(to_real(obj)) ? 1.0 : 0.0;
+}
+
+extern "C" variant instance_number(
+	scope *self, scope *other, const variant &obj
+) {
+	double id = to_real(obj);
+	if (!(id >= 0 && id < object_count)) return 0.0;
+
+	size_t count = 0;
+	for (unsigned object : pools()[(unsigned)id].descendants) {
+		count += pools()[object].live;
+	}
+	return (double)count;
+}
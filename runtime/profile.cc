@@ -0,0 +1,39 @@
+#include <dejavu/runtime/profile.h>
+#include <cstdio>
+#include <vector>
+
+namespace {
+	struct profile_entry {
+		const char *name;
+		uint64_t *counters;
+		unsigned count;
+	};
+}
+
+static std::vector<profile_entry> &entries() {
+	static std::vector<profile_entry> entries;
+	return entries;
+}
+
+extern "C" void profile_register(
+	const char *name, uint64_t *counters, unsigned count
+) {
+	entries().push_back(profile_entry{ name, counters, count });
+}
+
+void profile_dump() {
+	if (entries().empty()) return;
+
+	FILE *out = fopen(profile_path, "w");
+	if (!out) return;
+
+	for (const profile_entry &e : entries()) {
+		fprintf(out, "%s %u", e.name, e.count);
+		for (unsigned i = 0; i < e.count; i++) {
+			fprintf(out, " %llu", (unsigned long long)e.counters[i]);
+		}
+		fputc('\n', out);
+	}
+
+	fclose(out);
+}
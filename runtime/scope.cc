@@ -1,21 +1,94 @@
 #include <dejavu/runtime/scope.h>
+#include <dejavu/runtime/instance.h>
 #include <dejavu/runtime/error.h>
+#include <vector>
+
+// built on first use, since it needs the string pool. names keeps each slot's
+// name for scopes whose layout leaves it out
+struct slot_table {
+	slot_table() : slots(slot_count > 0 ? slot_count : 1) {}
+
+	table<string*, unsigned> slots;
+	std::vector<string*> names;
+};
+
+static slot_table &get_slot_table() {
+	static slot_table t;
+	static bool built = false;
+	if (!built) {
+		for (unsigned i = 0; i < slot_count; i++) {
+			string *name = strings.intern(slot_names[i]);
+			name->retain();
+			t.slots[name] = i;
+			t.names.push_back(name);
+		}
+		built = true;
+	}
+	return t;
+}
+
+int slot_of(string *name) {
+	table<string*, unsigned> &slots = get_slot_table().slots;
+	name = strings.canonical(name);
+	table<string*, unsigned>::node *n = slots.find(name);
+	return n != slots.end() ? n->v : -1;
+}
+
+string *slot_name(unsigned slot) {
+	return get_slot_table().names[slot];
+}
+
+// a variable that exists has been assigned at least once
+var *scope::find(string *name) {
+	int i = slot_of(name);
+	if (i >= 0) {
+		if (var *v = slot(i)) return v->x > 0 ? v : 0;
+		name = slot_name(i);
+	}
+
+	dynamic_table::node *n = dynamic.find(name);
+	return n != dynamic.end() ? &n->v : 0;
+}
+
+var &scope::operator[](string *name) {
+	int i = slot_of(name);
+	if (i >= 0) {
+		if (var *v = slot(i)) return *v;
+		name = slot_name(i);
+	}
+
+	return dynamic[name];
+}
+
+void scope::release_vars() {
+	for (unsigned i = 0; i < nslots; i++) release_var(&slots[i]);
+	for (dynamic_table::node &n : dynamic.nodes()) release_var(&n.v);
+}
+
+unsigned scope_epoch = 0;
 
 static scope global;
 
 static table<string*, var*> globalvar;
+static var **globalvar_slots = new var*[slot_count]();
+
+extern "C" void insert_globalvar_slot(unsigned slot) {
+	globalvar_slots[slot] = global.slot(slot);
+}
+
 extern "C" void insert_globalvar(string *name) {
+	int slot = slot_of(name);
+	if (slot >= 0) return insert_globalvar_slot(slot);
+
+	name = strings.canonical(name);
 	globalvar[name] = &global[name];
 }
 
-extern "C" var *lookup(
-	scope *self, scope *other, double id, string *name, bool lvalue
-) {
-	scope *s = 0;
+static scope *resolve(scope *self, scope *other, double id) {
 	switch ((int)id) {
-	case -1: s = self; break;
-	case -2: s = other; break;
-	case -5: s = &global; break;
+	case -1: return self;
+	case -2: return other;
+	case -5: return &global;
 
 	// todo: check on all.foo
 	case -3: case -4:
@@ -25,24 +98,91 @@ extern "C" var *lookup(
 		show_error(self, other, "local is not supported", true);
 		return 0;
 
-	// todo: other instance access
-	default: return 0;
+	default: return find_instance(id);
 	}
+}
 
-	if (s->find(name) == s->end()) {
+// names s has no slot for are in its dynamic table
+static var *lookup_dynamic(
+	scope *self, scope *other, scope *s, string *name, bool lvalue
+) {
+	if (!s->find(name)) {
 		if (!lvalue) {
 			show_error(self, other, "variable does not exist", true);
 			return 0;
 		}
 
-		s->insert(name);
+		s->dynamic.insert(name);
 	}
 	return &(*s)[name];
 }
 
+static var *lookup_slot_in(
+	scope *self, scope *other, scope *s, unsigned slot, bool lvalue
+) {
+	var *v = s->slot(slot);
+	if (!v) return lookup_dynamic(self, other, s, slot_name(slot), lvalue);
+
+	if (v->x == 0 && !lvalue) {
+		show_error(self, other, "variable does not exist", true);
+		return 0;
+	}
+	return v;
+}
+
+extern "C" var *lookup_slot(
+	scope *self, scope *other, double id, unsigned slot, bool lvalue
+) {
+	scope *s = resolve(self, other, id);
+	if (!s) return 0;
+
+	return lookup_slot_in(self, other, s, slot, lvalue);
+}
+
+// only variables that already exist are cached, so a hit is always valid for
+// reads as well as writes. a dynamic variable moves when its table grows, so
+// only ones in the scope's layout are
+extern "C" var *lookup_cached(
+	lookup_cache *cache,
+	scope *self, scope *other, double id, unsigned slot, bool lvalue
+) {
+	scope *s = resolve(self, other, id);
+	if (!s) return 0;
+
+	var *v = lookup_slot_in(self, other, s, slot, lvalue);
+	if (v && v->x > 0 && v == s->slot(slot)) {
+		*cache = lookup_cache{ id, self, other, scope_epoch, v };
+	}
+	return v;
+}
+
+extern "C" var *lookup(
+	scope *self, scope *other, double id, string *name, bool lvalue
+) {
+	int slot = slot_of(name);
+	if (slot >= 0) return lookup_slot(self, other, id, slot, lvalue);
+
+	scope *s = resolve(self, other, id);
+	if (!s) return 0;
+
+	return lookup_dynamic(self, other, s, strings.canonical(name), lvalue);
+}
+
+extern "C" var *lookup_default_slot(
+	scope *self, scope *other, unsigned slot, bool lvalue
+) {
+	if (globalvar_slots[slot]) return globalvar_slots[slot];
+
+	return lookup_slot(self, other, -1, slot, lvalue);
+}
+
 extern "C" var *lookup_default(
 	scope *self, scope *other, string *name, bool lvalue
 ) {
+	int slot = slot_of(name);
+	if (slot >= 0) return lookup_default_slot(self, other, slot, lvalue);
+
+	name = strings.canonical(name);
 	table<string*, var*>::node *n = globalvar.find(name);
 	if (n != globalvar.end()) {
 		return n->v;
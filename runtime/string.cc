@@ -12,12 +12,14 @@ extern "C" variant string(
 	case 0: {
 		// TODO: replace snprintf so we don't have to allocate one extra byte?
 		int length = snprintf(nullptr, 0, "%g", val.real);
-		struct string *str = new (length + 1) struct string(length);
+		arena::marker m = frame.mark();
+		struct string *str = new (frame, length + 1) struct string(length);
 
 		snprintf(str->data, length + 1, "%g", val.real);
 		str->hash = string::compute_hash(str->length, str->data);
 
-		struct string *ret = strings.intern(str);
+		struct string *ret = strings.intern_temporary(str);
+		frame.release(m);
 		ret->retain();
 		return ret;
 	}
@@ -21,34 +21,71 @@ extern "C" __attribute__((pure)) string *intern(string *s) {
 	return strings.intern(s);
 }
 
-extern "C" variant *access(
-	var *a, unsigned short x, unsigned short y, bool lvalue
-) {
-	if (x >= a->x || y >= a->y) {
-		if (!lvalue) {
-			show_error(0, 0, "index out of bounds", true);
-			return 0;
+// literals hold a reference forever, since generated code keeps the pointer
+extern "C" string *intern_literal(string *s) {
+	string *ret = strings.intern(s);
+	ret->retain();
+	return ret;
+}
+
+// capacity grows geometrically and apart from the size, so filling an array
+// in order is linear. rows are stride apart, so a new column only copies when
+// it doesn't fit the stride, and new rows only when they run out
+static void grow(var *a, unsigned nx, unsigned ny) {
+	nx = std::max(nx, a->x);
+	ny = std::max(ny, a->y);
+
+	if (nx > a->stride || ny > a->rows) {
+		unsigned stride = a->stride, rows = a->rows;
+		if (nx > stride) stride = std::max(nx, 2 * stride);
+		if (ny > rows) rows = std::max(ny, 2 * rows);
+
+		variant *contents = new variant[(size_t)stride * rows]();
+		if (stride == a->stride) {
+			memcpy(contents, a->contents, (size_t)a->y * stride * sizeof(*contents));
+		}
+		else {
+			// a borrowed array has a stride of 0, but only ever one row
+			for (size_t r = 0; r < a->y; r++) {
+				memcpy(
+					&contents[r * stride],
+					&a->contents[r * a->stride],
+					a->x * sizeof(*contents)
+				);
+			}
 		}
 
-		size_t nx = std::max((unsigned short)(x + 1), a->x);
-		size_t ny = std::max((unsigned short)(y + 1), a->y);
+		// a borrowed array's values still belong to its owner, so the copy
+		// takes references of its own
+		if (a->stride == 0) {
+			for (size_t i = 0; i < a->x; i++) retain(&contents[i]);
+		}
+		else {
+			delete[] a->contents;
+		}
+		a->stride = stride;
+		a->rows = rows;
+		a->contents = contents;
+	}
+
+	a->x = nx;
+	a->y = ny;
+}
 
-		variant *contents = new variant[nx * ny];
-		for (size_t r = 0; r < a->y; r++) {
-			memmove(
-				&contents[r * nx],
-				&a->contents[r * a->x],
-				a->x * sizeof(*contents)
-			);
+// anything stored through a borrowed array would change (and release) its
+// owner's values, so it's copied first
+extern "C" variant *access_var(var *a, unsigned x, unsigned y, bool lvalue) {
+	bool borrowed = a->stride == 0 && a->x > 0;
+	if (x >= a->x || y >= a->y || (lvalue && borrowed)) {
+		if (!lvalue) {
+			show_error(0, 0, "index out of bounds", true);
+			return 0;
 		}
 
-		delete[] a->contents;
-		a->x = nx;
-		a->y = ny;
-		a->contents = contents;
+		grow(a, x + 1, y + 1);
 	}
 
-	return &a->contents[x + y * a->x];
+	return &a->contents[x + (size_t)y * a->stride];
 }
 
 extern "C" void retain(variant *a) {
@@ -66,17 +103,18 @@ extern "C" void release(variant *a) {
 extern "C" void retain_var(var *a) {
 	for (size_t y = 0; y < a->y; y++) {
 		for (size_t x = 0; x < a->x; x++) {
-			variant *v = access(a, x, y);
-			retain(v);
+			retain(&a->contents[x + y * a->stride]);
 		}
 	}
 }
 
+// a borrowed array holds no references of its own
 extern "C" void release_var(var *a) {
+	if (a->stride == 0) return;
+
 	for (size_t y = 0; y < a->y; y++) {
 		for (size_t x = 0; x < a->x; x++) {
-			variant *v = access(a, x, y);
-			release(v);
+			release(&a->contents[x + y * a->stride]);
 		}
 	}
 	delete[] a->contents;
@@ -139,7 +177,16 @@ BINARY_OP_DEFAULT(less, <)
 BINARY_OP_DEFAULT(less_equals, <=)
 
 BINARY_OP(is_equals_real_real) { return a.real == b.real; }
-BINARY_OP(is_equals_string_string) { return a.string == b.string; }
+BINARY_OP(is_equals_string_string) {
+	if (a.string == b.string) return true;
+
+	// interned strings are equal only if they're the same, but builders aren't
+	// interned yet
+	if (a.string->capacity == 0 && b.string->capacity == 0) return false;
+	return
+		a.string->length == b.string->length &&
+		memcmp(a.string->data, b.string->data, a.string->length) == 0;
+}
 BINARY_OP(is_equals_default) { return false; }
 BINARY_TABLE(is_equals) = {
 	{ is_equals_real_real, is_equals_default }, { is_equals_default, is_equals_string_string }
@@ -156,16 +203,17 @@ BINARY_OP_DEFAULT(greater, >)
 BINARY_OP(plus_real_real) { return a.real + b.real; }
 BINARY_OP(plus_string_string) {
 	size_t length = a.string->length + b.string->length;
-	string *str = new (length) string(length);
+	arena::marker m = frame.mark();
+	string *str = new (frame, length) string(length);
 
 	memcpy((void*)str->data, (void*)a.string->data, a.string->length);
 	memcpy((void*)(str->data + a.string->length), (void*)b.string->data, b.string->length);
 	str->hash = string::compute_hash(str->length, str->data);
 
-	string *ret = strings.intern(str);
+	// the pool has its own copy now, so the frame can have its bytes back
+	string *ret = strings.intern_temporary(str);
+	frame.release(m);
 	ret->retain();
-
-	if (str != ret) delete str;
 	return ret;
 }
 BINARY_ERROR(plus, +)
@@ -188,3 +236,34 @@ BINARY_OP_REAL(shift_right, >>) { return (int)a.real >> (int)b.real; }
 
 BINARY_OP_REAL(div_, div) { return (int)(a.real / b.real); }
 BINARY_OP_REAL(mod, mod) { return fmod(a.real, b.real); }
+
+// s += x on a string that nothing else holds appends in place, with geometric
+// growth, so building a string in a loop is linear overall. the result is only
+// hashed and interned once something needs it as a name
+extern "C" void append(variant *a, variant *b) {
+	if (a->type != 1 || b->type != 1) {
+		variant r = plus(a, b);
+		release(a);
+		*a = r;
+		return;
+	}
+
+	string *s = a->string, *t = b->string;
+	size_t length = s->length + t->length;
+	if (s->capacity >= length && s->refcount == 1) {
+		memcpy(s->data + s->length, t->data, t->length);
+		s->length = length;
+		return;
+	}
+
+	size_t capacity = std::max(2 * length, (size_t)16);
+	string *str = new (capacity) string(length);
+	str->capacity = capacity;
+	str->pool = &strings;
+	memcpy(str->data, s->data, s->length);
+	memcpy(str->data + s->length, t->data, t->length);
+
+	str->retain();
+	s->release();
+	a->string = str;
+}
@@ -1,40 +1,95 @@
 #include <dejavu/system/arena.h>
-#include <cassert>
+#include <cstdint>
+
+static char *align_up(char *p, size_t align) {
+	uintptr_t n = reinterpret_cast<uintptr_t>(p);
+	return reinterpret_cast<char*>((n + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+void arena::free_slabs(slab *s) {
+	while (s) {
+		slab *next = s->next;
+		::operator delete(s);
+		s = next;
+	}
+}
 
 arena::arena(size_t slab_size) :
-	slab_size(slab_size), current_slab(NULL), bytes_allocated(0) {}
+	slab_size(slab_size), first_slab(nullptr), current_slab(nullptr),
+	large_slabs(nullptr), current(nullptr), end(nullptr), bytes_allocated(0) {}
 
 arena::~arena() {
-	while (current_slab) {
-		slab *next = current_slab->next;
-		::operator delete(current_slab);
-		current_slab = next;
-	}
+	free_slabs(first_slab);
+	free_slabs(large_slabs);
 }
 
-void *arena::allocate(size_t size) {
-	if (!current_slab) new_slab();
+// align is a power of two
+void *arena::allocate(size_t size, size_t align) {
 	bytes_allocated += size;
 
-	char *p = current; // TODO: align
-	if (p + size <= end) {
-		current = p + size;
-		return p;
+	if (size + align > slab_size - sizeof(slab))
+		return allocate_large(size, align);
+
+	char *p = align_up(current, align);
+	if (!current_slab || p + size > end) {
+		next_slab();
+		p = align_up(current, align);
 	}
 
-	new_slab();
-	p = current; // TODO: align
 	current = p + size;
-	assert(current <= end && "Unable to allocate memory");
 	return p;
 }
 
-void arena::new_slab() {
-	slab *s = static_cast<slab*>(::operator new(slab_size));
-	s->size = slab_size;
-	s->next = current_slab;
+void arena::reset() {
+	free_slabs(large_slabs);
+	large_slabs = nullptr;
+
+	current_slab = nullptr;
+	current = end = nullptr;
+	bytes_allocated = 0;
+}
+
+arena::marker arena::mark() const {
+	return marker{ current_slab, large_slabs, current, end, bytes_allocated };
+}
+
+// slabs used since the mark are kept for reuse, like reset does
+void arena::release(const marker &m) {
+	while (large_slabs != m.large_slabs) {
+		slab *next = large_slabs->next;
+		::operator delete(large_slabs);
+		large_slabs = next;
+	}
+
+	current_slab = m.current_slab;
+	current = m.current;
+	end = m.end;
+	bytes_allocated = m.bytes_allocated;
+}
+
+// moves on to the next slab after reset, or makes a new one
+void arena::next_slab() {
+	slab *s = current_slab ? current_slab->next : first_slab;
+	if (!s) {
+		s = static_cast<slab*>(::operator new(slab_size));
+		s->size = slab_size;
+		s->next = nullptr;
+
+		if (current_slab) current_slab->next = s;
+		else first_slab = s;
+	}
 
 	current_slab = s;
 	current = reinterpret_cast<char*>(current_slab + 1);
 	end = reinterpret_cast<char*>(current_slab) + current_slab->size;
 }
+
+void *arena::allocate_large(size_t size, size_t align) {
+	size_t total = sizeof(slab) + size + align;
+	slab *s = static_cast<slab*>(::operator new(total));
+	s->size = total;
+	s->next = large_slabs;
+	large_slabs = s;
+
+	return align_up(reinterpret_cast<char*>(s + 1), align);
+}
@@ -1,13 +1,37 @@
 #include <dejavu/system/string.h>
+#include <cstdint>
 #include <memory>
+#include <algorithm>
 
+static uint64_t read_word(const char *d) {
+	uint64_t w;
+	memcpy(&w, d, sizeof(w));
+	return w;
+}
+
+// the full-width product folded in half, as in wyhash
+static uint64_t mix(uint64_t a, uint64_t b) {
+	__uint128_t r = (__uint128_t)a * b;
+	return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+// every byte counts, eight at a time. this is computed in 64 bits so the
+// compiler and a runtime on a narrower target agree on the low bits
 size_t string::compute_hash(size_t l, const char *d) {
-	size_t hash = l;
-	size_t step = (l >> 5) + 1; // don't hash all chars of a long string
-	for (; l >= step; l -= step)
-		hash ^= (hash << 5) + (hash >> 2) + (unsigned char)d[l - 1];
+	const uint64_t k0 = 0xa0761d6478bd642full, k1 = 0xe7037ed1a0b428dbull;
+
+	uint64_t hash = mix(l ^ k0, k1);
+	for (; l >= 16; l -= 16, d += 16) {
+		hash = mix(read_word(d) ^ k1, read_word(d + 8) ^ hash);
+	}
+	if (l >= 8) {
+		hash = mix(read_word(d) ^ k1, hash ^ k0);
+		l -= 8; d += 8;
+	}
 
-	return hash;
+	uint64_t tail = 0;
+	if (l > 0) memcpy(&tail, d, l);
+	return mix(tail ^ k1, hash ^ k0);
 }
 
 string::string(size_t l, const char *d)
@@ -15,13 +39,130 @@ string::string(size_t l, const char *d)
 	memcpy(data, d, length);
 }
 
+string *string_pool::intern(const char *str, size_t len) {
+	size_t hash = string::compute_hash(len, str);
+	slot *s = find(hash, len, str);
+	if (s->str) {
+		return s->str;
+	}
+
+	string *ret = new (len) string(len);
+	ret->hash = hash;
+	memcpy(ret->data, str, len);
+	insert(s, ret);
+	return ret;
+}
+
+// if a builder has no interned twin it becomes that string itself, and stops
+// being appended to in place
 string *string_pool::intern(string *str) {
-	string_table::node *n = pool.find(str);
-	if (n != pool.end()) {
-		return n->k;
+	if (str->capacity > 0) {
+		str->hash = string::compute_hash(str->length, str->data);
 	}
 
-	pool.insert(str);
-	str->pool = this;
+	slot *s = find(str->hash, str->length, str->data);
+	if (s->str) {
+		return s->str;
+	}
+
+	insert(s, str);
+	str->capacity = 0;
 	return str;
 }
+
+string *string_pool::intern_temporary(string *str) {
+	slot *s = find(str->hash, str->length, str->data);
+	if (s->str) {
+		return s->str;
+	}
+
+	string *copy = new (str->length) string(str->length);
+	copy->hash = str->hash;
+	memcpy(copy->data, str->data, str->length);
+	insert(s, copy);
+	return copy;
+}
+
+string_pool::slot *string_pool::find(
+	size_t hash, size_t length, const char *data
+) {
+	if (!slots) resize(16);
+
+	for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+		slot &s = slots[i];
+		if (!s.str) return &s;
+
+		if (
+			s.hash == hash && s.str->length == length &&
+			memcmp(s.str->data, data, length) == 0
+		)
+			return &s;
+	}
+}
+
+// kept at most half full, so probes stay short
+void string_pool::insert(slot *s, string *str) {
+	s->hash = str->hash;
+	s->str = str;
+	str->pool = this;
+
+	if (++count * 2 > mask + 1) resize(2 * (mask + 1));
+}
+
+// every entry after the removed one, up to the next empty slot, moves back
+// unless that would put it before its home slot
+void string_pool::remove(string *str) {
+	size_t i = str->hash & mask;
+	while (slots[i].str != str) {
+		if (!slots[i].str) return;
+		i = (i + 1) & mask;
+	}
+
+	for (size_t j = (i + 1) & mask; slots[j].str; j = (j + 1) & mask) {
+		size_t home = slots[j].hash & mask;
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			slots[i] = slots[j];
+			i = j;
+		}
+	}
+
+	slots[i].str = nullptr;
+	count--;
+}
+
+void string_pool::resize(size_t length) {
+	slot *old = slots;
+	size_t old_length = slots ? mask + 1 : 0;
+
+	slots = new slot[length]();
+	mask = length - 1;
+
+	for (size_t i = 0; i < old_length; i++) {
+		if (!old[i].str) continue;
+
+		size_t j = old[i].hash & mask;
+		while (slots[j].str) j = (j + 1) & mask;
+		slots[j] = old[i];
+	}
+
+	delete[] old;
+}
+
+void string_pool::end_batch() {
+	if (--batch > 0) return;
+	sweep();
+}
+
+void string_pool::sweep() {
+	// a string can die more than once per batch if it's revived in between
+	std::sort(dead.begin(), dead.end());
+	dead.erase(std::unique(dead.begin(), dead.end()), dead.end());
+
+	for (string *str : dead) {
+		if (str->refcount > 0) continue;
+
+		if (str->capacity == 0) remove(str);
+		delete str;
+	}
+	dead.clear();
+}
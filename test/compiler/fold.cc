@@ -0,0 +1,159 @@
+#include <dejavu/compiler/fold.h>
+#include "parse.h"
+
+// nodes only live as long as this, which is the whole run
+static arena allocator;
+
+static block *fold(const char *code) {
+	node *program = node_folder(allocator).fold(parse(allocator, code));
+	EXPECT_EQ(block_node, program->type);
+	return static_cast<block*>(program);
+}
+
+// the right side of x = e, after folding
+static expression *fold_expression(const char *code) {
+	block *b = fold(code);
+	EXPECT_EQ(assignment_node, b->stmts[0]->type);
+	return static_cast<assignment*>(b->stmts[0])->rvalue;
+}
+
+static void expect_real(double real, const char *code) {
+	expression *e = fold_expression(code);
+	ASSERT_EQ(value_node, e->type) << code;
+	ASSERT_EQ(v_real, static_cast<value*>(e)->t.type) << code;
+	EXPECT_EQ(real, static_cast<value*>(e)->t.real) << code;
+}
+
+static void expect_kept(const char *code) {
+	EXPECT_NE(value_node, fold_expression(code)->type) << code;
+}
+
+static bool is_empty(statement *stmt) {
+	return stmt->type == block_node && static_cast<block*>(stmt)->stmts.empty();
+}
+
+TEST(fold, arithmetic) {
+	expect_real(7, "x = 1 + 2 * 3");
+	expect_real(-2, "x = -4 / 2");
+	expect_real(1, "x = 7 mod 3");
+	expect_real(3, "x = 7 div 2");
+	expect_real(9, "x = 5 & 3 | 8");
+	expect_real(6, "x = 5 ^ 3");
+	expect_real(16, "x = 1 << 4");
+	expect_real(-1, "x = ~0");
+	expect_real(1, "x = !0");
+
+	// only the constant part of an expression folds
+	expression *e = fold_expression("x = a + (1 + 2)");
+	ASSERT_EQ(binary_node, e->type);
+	expression *right = static_cast<binary*>(e)->right;
+	ASSERT_EQ(value_node, right->type);
+	EXPECT_EQ(3, static_cast<value*>(right)->t.real);
+}
+
+TEST(fold, comparison) {
+	expect_real(1, "x = 1 < 2");
+	expect_real(0, "x = 2 == 3");
+	expect_real(1, "x = 2 >= 2");
+	expect_real(0, "x = true && false");
+	expect_real(1, "x = 0 || 2");
+	expect_real(1, "x = 1 ^^ 0");
+}
+
+TEST(fold, string) {
+	expression *e = fold_expression("x = \"ab\" + 'cd'");
+	ASSERT_EQ(value_node, e->type);
+	token &t = static_cast<value*>(e)->t;
+	ASSERT_EQ(v_string, t.type);
+	EXPECT_EQ("abcd", std::string(t.string.data, t.string.length));
+
+	expect_real(1, "x = \"a\" + \"b\" == \"ab\"");
+	expect_real(1, "x = \"a\" != \"ab\"");
+	expect_real(0, "x = \"a\" != \"a\"");
+
+	// ordering and mixed types are left to the runtime
+	expect_kept("x = \"a\" < \"b\"");
+	expect_kept("x = \"a\" + 1");
+}
+
+// anything codegen doesn't define is left for runtime
+TEST(fold, undefined) {
+	expect_kept("x = 1 / 0");
+	expect_kept("x = 1 mod 0");
+	expect_kept("x = 1 div 0");
+	expect_kept("x = 1e10 div 1");
+
+	expect_kept("x = 1 << 32");
+	expect_kept("x = 1 >> -1");
+	expect_kept("x = 3000000000 | 0");
+	expect_kept("x = 1 & -3000000000");
+	expect_kept("x = ~3000000000");
+}
+
+TEST(fold, dead_if) {
+	block *b = fold("if (0) { a = 1 } else { b = 2 } if (1) c = 3 if (0) d = 4");
+	ASSERT_EQ(3u, b->stmts.size());
+	EXPECT_EQ(block_node, b->stmts[0]->type);
+	EXPECT_EQ(assignment_node, b->stmts[1]->type);
+	EXPECT_TRUE(is_empty(b->stmts[2]));
+
+	// the condition is folded first
+	b = fold("if (2 > 3) f()");
+	EXPECT_TRUE(is_empty(b->stmts[0]));
+}
+
+// declarations and case labels reach outside the branch they're in
+TEST(fold, dead_declarations) {
+	block *b = fold("if (0) { var i; i = 1 } if (1) a = 1 else globalvar g;");
+	EXPECT_EQ(ifstatement_node, b->stmts[0]->type);
+	EXPECT_EQ(ifstatement_node, b->stmts[1]->type);
+
+	b = fold("while (0) { var i; } while (false) { if (1) { globalvar g; } }");
+	EXPECT_EQ(whilestatement_node, b->stmts[0]->type);
+	EXPECT_EQ(whilestatement_node, b->stmts[1]->type);
+
+	b = fold("switch (x) { case 1: if (0) { case 2: a = 1 } }");
+	ASSERT_EQ(switchstatement_node, b->stmts[0]->type);
+	block *cases = static_cast<switchstatement*>(b->stmts[0])->stmts;
+	EXPECT_EQ(ifstatement_node, cases->stmts[1]->type);
+}
+
+// a branch that never runs can't have effects, whatever it calls or assigns
+TEST(fold, dead_effects) {
+	block *b = fold("if (0) { a = 1; f(); with (all) g() } while (0) { b[0] += h() }");
+	EXPECT_TRUE(is_empty(b->stmts[0]));
+	EXPECT_TRUE(is_empty(b->stmts[1]));
+}
+
+TEST(fold, dead_while) {
+	block *b = fold("while (0) a = 1 while (1) break while (x) a = 1");
+	EXPECT_TRUE(is_empty(b->stmts[0]));
+	EXPECT_EQ(whilestatement_node, b->stmts[1]->type);
+	EXPECT_EQ(whilestatement_node, b->stmts[2]->type);
+}
+
+TEST(fold, repeat) {
+	block *b = fold("repeat (0) a = 1 repeat (-1) a = 1 repeat (2) a = 1");
+	EXPECT_TRUE(is_empty(b->stmts[0]));
+	EXPECT_TRUE(is_empty(b->stmts[1]));
+	EXPECT_EQ(repeatstatement_node, b->stmts[2]->type);
+
+	b = fold("repeat (0) { var i; } repeat (n) a = 1");
+	EXPECT_EQ(repeatstatement_node, b->stmts[0]->type);
+	EXPECT_EQ(repeatstatement_node, b->stmts[1]->type);
+}
+
+// the initializer runs even when the loop never does, assignment or call
+TEST(fold, dead_for) {
+	block *b = fold(
+		"for (i = 0; 0; i += 1) a = 1 "
+		"for (f(); false; g()) h() "
+		"for (i = 0; 1; i += 1) break "
+		"for (i = 0; 0; i += 1) { var j; }"
+	);
+	ASSERT_EQ(assignment_node, b->stmts[0]->type);
+	EXPECT_EQ(equals, static_cast<assignment*>(b->stmts[0])->op);
+	EXPECT_EQ(invocation_node, b->stmts[1]->type);
+	EXPECT_EQ(forstatement_node, b->stmts[2]->type);
+	EXPECT_EQ(forstatement_node, b->stmts[3]->type);
+}
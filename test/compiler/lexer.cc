@@ -0,0 +1,161 @@
+#include <dejavu/compiler/lexer.h>
+#include <dejavu/system/buffer.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+// every token up to and including eof. names and strings point into code. the
+// scanners work 16 bytes at a time, so the tests below slide their input
+// across a few chunk boundaries
+static std::vector<token> lex(const std::string &code) {
+	buffer b(code.size(), code.data());
+	token_stream tokens(b);
+
+	std::vector<token> result;
+	do {
+		result.push_back(tokens.gettoken());
+	} while (result.back().type != eof);
+	return result;
+}
+
+static void expect_at(const token &t, token_type type, size_t row, size_t col) {
+	EXPECT_EQ(type, t.type);
+	EXPECT_EQ(row, t.row);
+	EXPECT_EQ(col, t.col);
+}
+
+TEST(lexer, position) {
+	std::vector<token> t = lex("a = 1;\n\tb += \"c\"");
+	ASSERT_EQ(8u, t.size());
+	expect_at(t[0], v_name, 1, 1);
+	expect_at(t[1], equals, 1, 3);
+	expect_at(t[2], v_real, 1, 5);
+	expect_at(t[3], semicolon, 1, 6);
+	expect_at(t[4], v_name, 2, 5);
+	expect_at(t[5], plus_equals, 2, 7);
+	expect_at(t[6], v_string, 2, 10);
+	expect_at(t[7], eof, 2, 13);
+}
+
+TEST(lexer, tabs) {
+	for (size_t n = 0; n < 40; n++) {
+		std::vector<token> t = lex(std::string(n, '\t') + "a");
+		expect_at(t[0], v_name, 1, 1 + 4 * n);
+
+		t = lex(std::string(n, ' ') + std::string(n, '\t') + " a");
+		expect_at(t[0], v_name, 1, 2 + 5 * n);
+	}
+}
+
+TEST(lexer, crlf) {
+	for (size_t n = 0; n < 40; n++) {
+		std::vector<token> t = lex(std::string(n, ' ') + "\r\n\r\n\n\ra");
+		expect_at(t[0], v_name, 5, 1);
+	}
+}
+
+TEST(lexer, crlf_in_comment) {
+	for (size_t n = 0; n < 40; n++) {
+		std::string x(n, 'x');
+
+		std::vector<token> t = lex("/*" + x + "\r\n*/a");
+		expect_at(t[0], v_name, 2, 3);
+
+		// \r\n only counts once, but \n\r is two newlines
+		t = lex("/*" + x + "\r\n\r\n\n\r" + x + "*/a");
+		expect_at(t[0], v_name, 5, 3 + n);
+	}
+}
+
+TEST(lexer, crlf_in_string) {
+	for (size_t n = 0; n < 40; n++) {
+		std::vector<token> t = lex("\"" + std::string(n, 'x') + "\r\ny\" a");
+		expect_at(t[0], v_string, 1, 1);
+		EXPECT_EQ(n + 3, t[0].string.length);
+		expect_at(t[1], v_name, 2, 5);
+	}
+}
+
+TEST(lexer, comment) {
+	std::vector<token> t = lex("a /* one\n two\r\n three */ b");
+	expect_at(t[0], v_name, 1, 1);
+	expect_at(t[1], v_name, 3, 11);
+
+	t = lex("/* a*b */c // d\ne");
+	expect_at(t[0], v_name, 1, 10);
+	expect_at(t[1], v_name, 2, 1);
+
+	t = lex("a // b");
+	expect_at(t[1], eof, 1, 3);
+}
+
+TEST(lexer, multi_line_string) {
+	std::string code = "s = 'one\ntwo\r\nthree';";
+	std::vector<token> t = lex(code);
+	expect_at(t[2], v_string, 1, 5);
+	EXPECT_EQ("one\ntwo\r\nthree", std::string(t[2].string.data, t[2].string.length));
+	expect_at(t[3], semicolon, 3, 8);
+}
+
+TEST(lexer, name_boundary) {
+	static const char chars[] = "a_0Z";
+	for (size_t n = 1; n < 40; n++) {
+		std::string name;
+		for (size_t i = 0; i < n; i++) name += chars[i % 4];
+
+		std::string code = name + " b";
+		std::vector<token> t = lex(code);
+		expect_at(t[0], v_name, 1, 1);
+		EXPECT_EQ(name, std::string(t[0].string.data, t[0].string.length));
+		expect_at(t[1], v_name, 1, n + 2);
+
+		// and at the end of the buffer
+		t = lex(name);
+		ASSERT_EQ(2u, t.size());
+		EXPECT_EQ(n, t[0].string.length);
+		expect_at(t[1], eof, 1, n + 1);
+	}
+}
+
+// the keyword hash only ever has to recognize these
+static const std::pair<std::string, token_type> keyword_tokens[] = {
+	{ "begin", l_brace }, { "end", r_brace },
+	{ "not", exclaim }, { "and", ampamp }, { "or", pipepipe }, { "xor", caretcaret },
+#	define KEYWORD(X) { #X, kw_ ## X },
+#	include <dejavu/compiler/tokens.tbl>
+};
+
+static token_type keyword(const std::string &name) {
+	for (auto &k : keyword_tokens) {
+		if (k.first == name) return k.second;
+	}
+	return v_name;
+}
+
+TEST(lexer, keywords) {
+	for (auto &k : keyword_tokens) {
+		std::vector<token> t = lex(k.first);
+		EXPECT_EQ(k.second, t[0].type) << k.first;
+		EXPECT_EQ(k.first.size(), t[0].string.length) << k.first;
+	}
+}
+
+// anything close to a keyword is a name, unless it's another keyword
+TEST(lexer, near_keywords) {
+	for (auto &k : keyword_tokens) {
+		const std::string &name = k.first;
+
+		std::vector<std::string> near = {
+			name + "x", "x" + name, name + "_", name + "0",
+			name.substr(1), std::string(1, name[0] - 'a' + 'A') + name.substr(1),
+			name.substr(0, name.size() - 1) + (name.back() == 'z' ? 'a' : char(name.back() + 1)),
+		};
+		for (size_t n = 1; n < name.size(); n++) near.push_back(name.substr(0, n));
+
+		for (const std::string &code : near) {
+			std::vector<token> t = lex(code);
+			EXPECT_EQ(keyword(code), t[0].type) << code;
+			EXPECT_EQ(code.size(), t[0].string.length) << code;
+		}
+	}
+}
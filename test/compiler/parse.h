@@ -0,0 +1,36 @@
+#ifndef TEST_PARSE_H
+#define TEST_PARSE_H
+
+#include <dejavu/compiler/parser.h>
+#include <dejavu/system/buffer.h>
+#include <gtest/gtest.h>
+#include <cstring>
+
+struct test_errors : public error_stream {
+	void set_context(const std::string &) {}
+	int count() { return errors; }
+
+	void error(const unexpected_token_error &) { errors++; }
+	void error(const redefinition_error &) { errors++; }
+	void error(const unsupported_error &) { errors++; }
+	void error(const std::string &) { errors++; }
+
+	void progress(int, const std::string &) {}
+
+	int errors = 0;
+};
+
+// the tree for code, in allocator. names and strings point into code, so it
+// has to outlive the tree
+inline node *parse(arena &allocator, const char *code) {
+	buffer b(strlen(code), code);
+	token_stream tokens(b);
+	test_errors errors;
+
+	parser p(tokens, allocator, errors);
+	node *program = p.getprogram();
+	EXPECT_EQ(0, errors.count());
+	return program;
+}
+
+#endif
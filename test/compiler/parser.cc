@@ -0,0 +1,102 @@
+#include <dejavu/compiler/parser.h>
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <vector>
+
+// what the table built at startup used to hold. each handler is named by the
+// first token that has it, and unexpected means none
+struct expected_symbol {
+	int precedence = 0;
+	token_type std = unexpected, nud = unexpected, led = unexpected;
+};
+
+struct expected_table {
+	expected_table() : symbols(token_count) {
+		nud({ v_name, v_real, v_string, kw_self, kw_other, kw_all, kw_noone,
+			kw_global, kw_local, kw_true, kw_false });
+		nud({ l_paren });
+		nud({ exclaim, tilde, minus, plus });
+		nud({ eof });
+
+		led(90, { dot });
+		led(80, { l_paren });
+		led(80, { l_square });
+		led(60, { times, divide, kw_div, kw_mod });
+		led(50, { plus, minus }, times);
+		led(40, { shift_left, shift_right }, times);
+		led(30, { bit_and, bit_or, bit_xor }, times);
+		led(20, { less, less_equals, is_equals, equals, not_equals, greater,
+			greater_equals }, times);
+		led(10, { ampamp, pipepipe, caretcaret }, times);
+
+		statement({ kw_var, kw_globalvar });
+		statement({ v_name, l_paren, kw_self, kw_other, kw_all, kw_noone, kw_global,
+			kw_local });
+		statement({ l_brace });
+		statement({ kw_if });
+		statement({ kw_while });
+		statement({ kw_do });
+		statement({ kw_repeat });
+		statement({ kw_for });
+		statement({ kw_switch });
+		statement({ kw_with });
+		statement({ kw_break, kw_continue, kw_exit });
+		statement({ kw_return });
+		statement({ kw_case, kw_default });
+		statement({ eof });
+	}
+
+	void nud(std::initializer_list<token_type> tokens) {
+		nuds.push_back(*tokens.begin());
+		for (token_type t : tokens) symbols[t].nud = *tokens.begin();
+	}
+
+	// infix_led is shared between precedences, so later groups name the first
+	void led(int prec, std::initializer_list<token_type> tokens, token_type same = unexpected) {
+		token_type first = same != unexpected ? same : *tokens.begin();
+		if (same == unexpected) leds.push_back(first);
+		for (token_type t : tokens) {
+			symbols[t].precedence = prec;
+			symbols[t].led = first;
+		}
+	}
+
+	void statement(std::initializer_list<token_type> tokens) {
+		stds.push_back(*tokens.begin());
+		for (token_type t : tokens) symbols[t].std = *tokens.begin();
+	}
+
+	std::vector<expected_symbol> symbols;
+	std::vector<token_type> stds, nuds, leds;
+};
+
+TEST(parser, symbols) {
+	expected_table expected;
+	for (size_t i = 0; i < token_count; i++) {
+		token_type t = static_cast<token_type>(i);
+		const expected_symbol &e = expected.symbols[i];
+		const symbol &s = symbols[t];
+
+		EXPECT_EQ(e.precedence, s.precedence) << t;
+		if (e.std == unexpected) EXPECT_TRUE(s.std == nullptr) << t;
+		else EXPECT_TRUE(s.std && s.std == symbols[e.std].std) << t;
+		if (e.nud == unexpected) EXPECT_TRUE(s.nud == nullptr) << t;
+		else EXPECT_TRUE(s.nud && s.nud == symbols[e.nud].nud) << t;
+		if (e.led == unexpected) EXPECT_TRUE(s.led == nullptr) << t;
+		else EXPECT_TRUE(s.led && s.led == symbols[e.led].led) << t;
+	}
+
+	// and the handlers named differently really are different
+	for (size_t i = 0; i < expected.stds.size(); i++) {
+		for (size_t j = 0; j < i; j++)
+			EXPECT_TRUE(symbols[expected.stds[i]].std != symbols[expected.stds[j]].std);
+	}
+	for (size_t i = 0; i < expected.nuds.size(); i++) {
+		for (size_t j = 0; j < i; j++)
+			EXPECT_TRUE(symbols[expected.nuds[i]].nud != symbols[expected.nuds[j]].nud);
+	}
+	for (size_t i = 0; i < expected.leds.size(); i++) {
+		for (size_t j = 0; j < i; j++)
+			EXPECT_TRUE(symbols[expected.leds[i]].led != symbols[expected.leds[j]].led);
+	}
+}
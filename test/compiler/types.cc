@@ -0,0 +1,60 @@
+#include <dejavu/compiler/types.h>
+#include <dejavu/compiler/fold.h>
+#include "parse.h"
+
+// what the linker works out for a script before it generates any calls
+static script_signature analyze(
+	const char *code, const script_signatures *scripts = 0
+) {
+	arena allocator;
+	node *program = node_folder(allocator).fold(parse(allocator, code));
+
+	node_types types;
+	types.set_scripts(scripts);
+	types.analyze(program, true);
+	return types.signature();
+}
+
+TEST(types, real_script) {
+	script_signature s = analyze("var i; i = argument[0] * 2; return i + 1");
+	EXPECT_FALSE(s.real);
+
+	s = analyze("var i; i = 2; if (argument_count > 1) return i; return -i");
+	EXPECT_TRUE(s.real);
+
+	s = analyze("a = 1");
+	EXPECT_TRUE(s.real);
+
+	s = analyze("return \"a\"");
+	EXPECT_FALSE(s.real);
+}
+
+TEST(types, real_call) {
+	script_signatures scripts;
+	scripts["scr_real"].real = true;
+	scripts["scr_boxed"];
+
+	EXPECT_TRUE(analyze("return scr_real() + 1", &scripts).real);
+	EXPECT_FALSE(analyze("return scr_boxed() + 1", &scripts).real);
+	EXPECT_FALSE(analyze("return scr_real() + 1").real);
+}
+
+TEST(types, fixed_arity) {
+	script_signature s = analyze("return argument[0] + argument[2]");
+	EXPECT_TRUE(s.fixed);
+	EXPECT_EQ(3u, s.arity);
+
+	s = analyze("argument[1] = argument");
+	EXPECT_TRUE(s.fixed);
+	EXPECT_EQ(2u, s.arity);
+
+	s = analyze("return argument_count");
+	EXPECT_TRUE(s.fixed);
+	EXPECT_EQ(0u, s.arity);
+
+	s = analyze("var i; i = 0; return argument[i]");
+	EXPECT_FALSE(s.fixed);
+
+	s = analyze("return argument[100]");
+	EXPECT_FALSE(s.fixed);
+}
@@ -0,0 +1,210 @@
+#include <dejavu/linker/packed_game.h>
+#include <dejavu/linker/project_file.h>
+#include <gtest/gtest.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// what Writer.pack() produces. words keeps the buffer aligned for ints()
+struct packer {
+	void u32(uint32_t v) { words.push_back(v); }
+
+	void str(const char *s) {
+		size_t n = strlen(s);
+		u32(n);
+
+		std::vector<uint32_t> padded((n + 4) / 4, 0);
+		memcpy(padded.data(), s, n);
+		words.insert(words.end(), padded.begin(), padded.end());
+	}
+
+	const char *data() const { return reinterpret_cast<const char*>(words.data()); }
+	size_t size() const { return 4 * words.size(); }
+
+	std::vector<uint32_t> words;
+};
+
+// field offsets into the game below, for corrupting it
+struct offsets {
+	size_t name, kind, exec, type, arg_kind;
+};
+
+// one action type with two arguments, one script, and one object with one
+// event running one action
+static packer pack_game(offsets *at = 0, uint32_t action_type_index = 0) {
+	packer p;
+	p.u32(800);
+	if (at) at->name = p.size();
+	p.str("game");
+
+	p.u32(1);
+	p.u32(603);
+	p.u32(1);
+	if (at) at->kind = p.size();
+	p.u32(action_type::act_code);
+	p.u32(0);
+	p.u32(1);
+	if (at) at->exec = p.size();
+	p.u32(action_type::exec_code);
+	p.str("action_code");
+	p.u32(2);
+	p.u32(argument::arg_expr);
+	p.u32(argument::arg_object);
+
+	p.u32(1);
+	p.u32(7);
+	p.str("scr_0");
+	p.str("return 1");
+
+	p.u32(1);
+	p.u32(3);
+	p.str("obj_0");
+	p.u32(-1);
+	p.u32(-1);
+	p.u32(-100);
+	p.u32(1);
+	p.u32(1);
+	p.u32(0);
+	p.u32(5);
+
+	p.u32(1);
+	p.u32(0);
+	p.u32(0);
+
+	p.u32(1);
+	if (at) at->type = p.size();
+	p.u32(action_type_index);
+	p.u32(0);
+	p.u32(1);
+	p.u32(action::self);
+
+	p.u32(2);
+	if (at) at->arg_kind = p.size();
+	p.u32(argument::arg_expr);
+	p.str("x + 1");
+	p.u32(-1);
+	p.u32(argument::arg_object);
+	p.str("");
+	p.u32(3);
+
+	return p;
+}
+
+TEST(packed_game, round_trip) {
+	packer p = pack_game();
+	packed_game packed(p.data(), p.size());
+	ASSERT_TRUE(packed.valid());
+
+	game &g = packed.get();
+	EXPECT_EQ(800, g.version);
+	EXPECT_STREQ("game", g.name);
+
+	ASSERT_EQ(1u, g.nactions);
+	action_type &type = g.actions[0];
+	EXPECT_EQ(603, type.id);
+	EXPECT_EQ(action_type::act_code, type.kind);
+	EXPECT_TRUE(type.relative);
+	EXPECT_EQ(action_type::exec_code, type.exec);
+	EXPECT_STREQ("action_code", type.code);
+	ASSERT_EQ(2u, type.nargs);
+	EXPECT_EQ(argument::arg_object, type.args[1]);
+
+	ASSERT_EQ(1u, g.nscripts);
+	EXPECT_EQ(7u, g.scripts[0].id);
+	EXPECT_STREQ("scr_0", g.scripts[0].name);
+	EXPECT_STREQ("return 1", g.scripts[0].code);
+
+	ASSERT_EQ(1u, g.nobjects);
+	object &obj = g.objects[0];
+	EXPECT_STREQ("obj_0", obj.name);
+	EXPECT_EQ(-100, obj.parent);
+	EXPECT_TRUE(obj.solid);
+	EXPECT_FALSE(obj.persistent);
+	EXPECT_EQ(5, obj.depth);
+
+	ASSERT_EQ(1u, obj.nevents);
+	ASSERT_EQ(1u, obj.events[0].nactions);
+	action &act = obj.events[0].actions[0];
+	EXPECT_EQ(&type, act.type);
+	EXPECT_EQ(action::self, act.target);
+
+	ASSERT_EQ(2u, act.nargs);
+	EXPECT_STREQ("x + 1", act.args[0].val);
+	EXPECT_EQ(argument::arg_object, act.args[1].kind);
+	EXPECT_STREQ("", act.args[1].val);
+	EXPECT_EQ(3u, act.args[1].resource);
+}
+
+TEST(packed_game, truncated) {
+	packer p = pack_game();
+	for (size_t n = 0; n < p.size(); n++) {
+		packed_game packed(p.data(), n);
+		EXPECT_FALSE(packed.valid()) << n;
+	}
+}
+
+TEST(packed_game, bad_action_type) {
+	packer p = pack_game(0, 1);
+	EXPECT_FALSE(packed_game(p.data(), p.size()).valid());
+}
+
+TEST(packed_game, bad_string) {
+	offsets at;
+	packer p = pack_game(&at);
+	char *name = reinterpret_cast<char*>(p.words.data()) + at.name;
+
+	// the nul after "game" is missing
+	name[4 + 4] = 'x';
+	EXPECT_FALSE(packed_game(p.data(), p.size()).valid());
+
+	// or the length runs past the end
+	name[4 + 4] = '\0';
+	p.words[at.name / 4] = p.size();
+	EXPECT_FALSE(packed_game(p.data(), p.size()).valid());
+}
+
+TEST(packed_game, bad_enum) {
+	offsets at;
+	pack_game(&at);
+
+	for (size_t offset : { at.kind, at.exec, at.arg_kind }) {
+		packer p = pack_game();
+		p.words[offset / 4] = 100;
+		EXPECT_FALSE(packed_game(p.data(), p.size()).valid()) << offset;
+	}
+}
+
+// the header project_file expects, then the game
+static std::string write_project(const char magic[4], uint32_t version) {
+	char path[] = "/tmp/dejavu-project-XXXXXX";
+	int fd = mkstemp(path);
+	EXPECT_NE(-1, fd);
+
+	packer p = pack_game();
+	EXPECT_EQ(4, write(fd, magic, 4));
+	EXPECT_EQ(4, write(fd, &version, 4));
+	EXPECT_EQ((ssize_t)p.size(), write(fd, p.data(), p.size()));
+	close(fd);
+
+	return path;
+}
+
+TEST(project_file, open) {
+	std::string path = write_project("djvp", 1);
+	project_file project;
+	ASSERT_EQ(0, project.open_file(path.c_str()));
+	EXPECT_STREQ("scr_0", project.get().scripts[0].name);
+	unlink(path.c_str());
+
+	path = write_project("djvq", 1);
+	EXPECT_EQ(EINVAL, project_file().open_file(path.c_str()));
+	unlink(path.c_str());
+
+	path = write_project("djvp", 2);
+	EXPECT_EQ(EINVAL, project_file().open_file(path.c_str()));
+	unlink(path.c_str());
+}
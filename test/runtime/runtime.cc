@@ -0,0 +1,15 @@
+#include <dejavu/runtime/instance.h>
+
+// what game.cc would otherwise provide
+string_pool strings;
+arena frame;
+
+// and what the linker would fill in. object 1 inherits from object 0, which
+// only uses a. test/runtime/scope.cc depends on these
+extern "C" const unsigned slot_count = 3;
+extern "C" const char *const slot_names[] = { "a", "b", "x" };
+
+extern "C" const unsigned object_count = 2;
+extern "C" const int object_parents[] = { -1, 0 };
+extern "C" const unsigned object_layouts[] = { 0, 0, 1 };
+extern "C" const unsigned object_layout_offsets[] = { 0, 1, 3 };
@@ -0,0 +1,112 @@
+#include <dejavu/runtime/instance.h>
+#include <gtest/gtest.h>
+
+extern "C" variant instance_create(
+	scope *self, scope *other,
+	const variant &x, const variant &y, const variant &obj
+);
+extern "C" variant instance_destroy(scope *self, scope *other);
+extern "C" variant instance_exists(
+	scope *self, scope *other, const variant &obj
+);
+extern "C" variant instance_number(
+	scope *self, scope *other, const variant &obj
+);
+
+TEST(scope, layout) {
+	scope global;
+	EXPECT_EQ(slot_count, global.nslots);
+	EXPECT_EQ(&global.slots[2], global.slot(2));
+
+	instance parent(0, 0), child(1, 1);
+	EXPECT_EQ(1u, parent.nslots);
+	EXPECT_NE(nullptr, parent.slot(0));
+	EXPECT_EQ(nullptr, parent.slot(1));
+
+	EXPECT_EQ(2u, child.nslots);
+	EXPECT_NE(nullptr, child.slot(1));
+	EXPECT_EQ(nullptr, child.slot(2));
+}
+
+TEST(scope, dynamic_slot) {
+	instance i(0, 0);
+	string *b = strings.intern("b");
+	EXPECT_EQ(nullptr, i.find(b));
+
+	var &v = i[b];
+	*access_var(&v, 0, 0, true) = 1.0;
+	EXPECT_EQ(&v, i.find(b));
+	EXPECT_EQ(&v, &i.dynamic.find(slot_name(1))->v);
+
+	i.release_vars();
+}
+
+TEST(scope, lookup_dynamic_slot) {
+	scope self, other;
+	double id = instance_create(&self, &other, 0.0, 0.0, 0.0).real;
+	flush_instances();
+
+	// a is in object 0's layout, so it can be cached
+	lookup_cache a_cache = {};
+	var *a = lookup_cached(&a_cache, &self, &other, id, 0, true);
+	*access_var(a, 0, 0, true) = 1.0;
+	EXPECT_EQ(a, lookup_cached(&a_cache, &self, &other, id, 0, false));
+	EXPECT_EQ(a, a_cache.result);
+
+	// but b isn't, so it lives in the dynamic table and never is
+	lookup_cache b_cache = {};
+	var *b = lookup_cached(&b_cache, &self, &other, id, 1, true);
+	*access_var(b, 0, 0, true) = 2.0;
+	EXPECT_EQ(b, lookup_cached(&b_cache, &self, &other, id, 1, false));
+	EXPECT_EQ(nullptr, b_cache.result);
+	EXPECT_EQ(2.0, access_var(b, 0, 0)->real);
+
+	instance_destroy(find_instance(id), &other);
+	flush_instances();
+}
+
+TEST(scope, create_then_query) {
+	scope self, other;
+	variant parent = 0.0, child = 1.0;
+	EXPECT_EQ(0.0, instance_exists(&self, &other, child).real);
+
+	// nothing has been flushed, but the instance can already be found
+	double id = instance_create(&self, &other, 0.0, 0.0, child).real;
+	EXPECT_EQ(1.0, instance_exists(&self, &other, child).real);
+	EXPECT_EQ(1.0, instance_number(&self, &other, parent).real);
+	EXPECT_EQ(find_instance(id), find_instance(0));
+
+	with_iterator it;
+	EXPECT_EQ(find_instance(id), with_begin(&it, &self, &other, &parent));
+	EXPECT_EQ(nullptr, with_inc(&it));
+
+	// and once it's destroyed it can't, even though it's still in its pool
+	instance_destroy(find_instance(id), &other);
+	EXPECT_EQ(0.0, instance_exists(&self, &other, child).real);
+	EXPECT_EQ(0.0, instance_number(&self, &other, parent).real);
+
+	flush_instances();
+	EXPECT_EQ(0.0, instance_number(&self, &other, parent).real);
+}
+
+TEST(scope, create_during_with) {
+	scope self, other;
+	variant object = 0.0;
+	double first = instance_create(&self, &other, 0.0, 0.0, object).real;
+
+	// the with only visits what existed when it started
+	with_iterator it;
+	EXPECT_EQ(find_instance(first), with_begin(&it, &self, &other, &object));
+	double second = instance_create(&self, &other, 0.0, 0.0, object).real;
+	EXPECT_EQ(nullptr, with_inc(&it));
+	EXPECT_EQ(2.0, instance_number(&self, &other, object).real);
+
+	// but the next one sees it
+	EXPECT_EQ(find_instance(first), with_begin(&it, &self, &other, &object));
+	EXPECT_EQ(find_instance(second), with_inc(&it));
+	EXPECT_EQ(nullptr, with_inc(&it));
+
+	instance_destroy(find_instance(first), &other);
+	instance_destroy(find_instance(second), &other);
+	flush_instances();
+}
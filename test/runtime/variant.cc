@@ -0,0 +1,223 @@
+#include <dejavu/runtime/variant.h>
+#include <gtest/gtest.h>
+
+// a script's argument borrows its caller's values, the way codegen's
+// make_local sets it up
+static var borrow(variant *args, unsigned n) {
+	return var{ n, 1, 0, 1, args };
+}
+
+TEST(variant, read_argument) {
+	variant args[] = { 1.0, 2.0 };
+	var argument = borrow(args, 2);
+
+	EXPECT_EQ(&args[1], access_var(&argument, 1, 0));
+	release_var(&argument);
+	EXPECT_EQ(args, argument.contents);
+}
+
+TEST(variant, assign_argument) {
+	string *s = strings.intern("caller");
+	s->retain();
+
+	variant args[] = { s, 1.0 };
+	var argument = borrow(args, 2);
+
+	// argument[0] = 2
+	variant *v = access_var(&argument, 0, 0, true);
+	EXPECT_NE(&args[0], v);
+	release(v);
+	*v = 2.0;
+
+	EXPECT_EQ(s, args[0].string);
+	EXPECT_EQ(1u, s->refcount);
+	EXPECT_EQ(2.0, access_var(&argument, 0, 0)->real);
+	EXPECT_EQ(1.0, access_var(&argument, 1, 0)->real);
+
+	release_var(&argument);
+	EXPECT_EQ(1u, s->refcount);
+	s->release();
+}
+
+TEST(variant, append_argument) {
+	variant caller = strings.intern("ab");
+	retain(&caller);
+	variant suffix = strings.intern("cd");
+
+	// a builder only the caller holds
+	append(&caller, &suffix);
+	ASSERT_NE(0u, caller.string->capacity);
+	ASSERT_EQ(1u, caller.string->refcount);
+
+	// argument[0] += "cd"
+	var argument = borrow(&caller, 1);
+	variant *v = access_var(&argument, 0, 0, true);
+	append(v, &suffix);
+
+	EXPECT_EQ(4u, caller.string->length);
+	EXPECT_EQ(0, memcmp("abcdcd", v->string->data, 6));
+	EXPECT_EQ(1u, caller.string->refcount);
+
+	release_var(&argument);
+	release(&caller);
+}
+
+extern "C" variant plus(variant *a, variant *b);
+
+TEST(variant, plus_frame) {
+	variant a = strings.intern("ab"), b = strings.intern("cd");
+	size_t before = frame.bytes();
+
+	variant c = plus(&a, &b);
+	EXPECT_EQ(strings.intern("abcd"), c.string);
+	EXPECT_EQ(before, frame.bytes());
+
+	release(&c);
+}
+
+// a switch compares its label literals with the interned switch value
+TEST(variant, switch_builder) {
+	variant v = strings.intern("ab");
+	retain(&v);
+	variant suffix = strings.intern("cd");
+
+	append(&v, &suffix);
+	ASSERT_NE(0u, v.string->capacity);
+
+	string *literal = strings.intern("abcd");
+	EXPECT_NE(literal, v.string);
+	EXPECT_EQ(literal, intern(v.string));
+
+	release(&v);
+}
+
+// every element written so far, checked after each write, which may have
+// moved them all
+static void fill(var &a, unsigned nx, unsigned ny, size_t &moves) {
+	for (unsigned y = 0; y < ny; y++) {
+		for (unsigned x = 0; x < nx; x++) {
+			variant *before = a.contents;
+			*access_var(&a, x, y, true) = x + 1000.0 * y;
+			if (a.contents != before) moves++;
+
+			for (unsigned j = 0; j <= y; j++) {
+				for (unsigned i = 0; i < (j < y ? nx : x + 1); i++) {
+					ASSERT_EQ(i + 1000.0 * j, access_var(&a, i, j)->real);
+				}
+			}
+		}
+	}
+}
+
+TEST(variant, grow_columns) {
+	var a = {};
+	size_t moves = 0;
+	fill(a, 100, 1, moves);
+
+	EXPECT_EQ(100u, a.x);
+	EXPECT_EQ(1u, a.y);
+	EXPECT_GE(a.stride, a.x);
+	EXPECT_LE(moves, 8u);
+
+	// the stride has room, so another column doesn't move anything
+	if (a.stride > a.x) {
+		variant *before = a.contents;
+		*access_var(&a, a.x, 0, true) = 1.0;
+		EXPECT_EQ(before, a.contents);
+	}
+
+	release_var(&a);
+}
+
+TEST(variant, grow_rows) {
+	var a = {};
+	size_t moves = 0;
+	fill(a, 1, 100, moves);
+
+	EXPECT_EQ(1u, a.x);
+	EXPECT_EQ(100u, a.y);
+	EXPECT_GE(a.rows, a.y);
+	EXPECT_LE(moves, 8u);
+
+	release_var(&a);
+}
+
+// widening every row moves them all to the new stride
+TEST(variant, grow_both) {
+	var a = {};
+	size_t moves = 0;
+	fill(a, 3, 5, moves);
+
+	unsigned stride = a.stride;
+	*access_var(&a, stride + 1, 2, true) = -1.0;
+	EXPECT_GT(a.stride, stride);
+	EXPECT_EQ(stride + 2, a.x);
+	EXPECT_EQ(5u, a.y);
+
+	for (unsigned y = 0; y < 5; y++) {
+		for (unsigned x = 0; x < 3; x++)
+			EXPECT_EQ(x + 1000.0 * y, access_var(&a, x, y)->real);
+		for (unsigned x = 3; x < a.x; x++) {
+			variant *v = access_var(&a, x, y);
+			EXPECT_EQ(x == stride + 1 && y == 2 ? -1.0 : 0.0, v->real);
+		}
+	}
+
+	release_var(&a);
+}
+
+// strings keep their one reference as they move
+TEST(variant, grow_strings) {
+	string *s = strings.intern("moved");
+	var a = {};
+	*access_var(&a, 0, 0, true) = s;
+	retain(access_var(&a, 0, 0));
+
+	for (unsigned x = 1; x < 50; x++) *access_var(&a, x, x % 3, true) = 1.0;
+	EXPECT_EQ(s, access_var(&a, 0, 0)->string);
+	EXPECT_EQ(1u, s->refcount);
+
+	release_var(&a);
+}
+
+TEST(variant, large_index) {
+	var a = {};
+	*access_var(&a, 0, 0, true) = 1.0;
+	*access_var(&a, 70000, 0, true) = 2.0;
+	EXPECT_EQ(70001u, a.x);
+	EXPECT_EQ(1.0, access_var(&a, 0, 0)->real);
+	EXPECT_EQ(2.0, access_var(&a, 70000, 0)->real);
+
+	release_var(&a);
+
+	var b = {};
+	*access_var(&b, 0, 0, true) = 1.0;
+	*access_var(&b, 0, 70000, true) = 3.0;
+	EXPECT_EQ(70001u, b.y);
+	EXPECT_EQ(1.0, access_var(&b, 0, 0)->real);
+	EXPECT_EQ(3.0, access_var(&b, 0, 70000)->real);
+
+	release_var(&b);
+}
+
+// growing a borrowed array copies it and leaves the caller's values alone
+TEST(variant, grow_argument) {
+	string *s = strings.intern("caller");
+	s->retain();
+
+	variant args[] = { s, 1.0 };
+	var argument = borrow(args, 2);
+
+	*access_var(&argument, 5, 0, true) = 2.0;
+	EXPECT_NE(args, argument.contents);
+	EXPECT_EQ(6u, argument.x);
+	EXPECT_EQ(s, access_var(&argument, 0, 0)->string);
+	EXPECT_EQ(1.0, access_var(&argument, 1, 0)->real);
+	EXPECT_EQ(2.0, access_var(&argument, 5, 0)->real);
+	EXPECT_EQ(2u, s->refcount);
+
+	release_var(&argument);
+	EXPECT_EQ(1u, s->refcount);
+	EXPECT_EQ(s, args[0].string);
+	s->release();
+}
@@ -0,0 +1,76 @@
+#include <dejavu/system/arena.h>
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+
+static bool aligned(void *p, size_t align) {
+	return reinterpret_cast<uintptr_t>(p) % align == 0;
+}
+
+TEST(arena, align) {
+	arena a(256);
+
+	a.allocate(1);
+	EXPECT_TRUE(aligned(a.allocate(8), alignof(std::max_align_t)));
+
+	a.allocate(3, 1);
+	EXPECT_TRUE(aligned(a.allocate(16, 64), 64));
+
+	char *p = static_cast<char*>(a.allocate(1, 1));
+	char *q = static_cast<char*>(a.allocate(1, 1));
+	EXPECT_EQ(p + 1, q);
+}
+
+TEST(arena, reset) {
+	arena a(256);
+
+	void *first = a.allocate(8);
+	for (int i = 0; i < 100; i++) a.allocate(64);
+
+	a.reset();
+	EXPECT_EQ(first, a.allocate(8));
+}
+
+TEST(arena, large) {
+	arena a(256);
+
+	char *p = static_cast<char*>(a.allocate(4096));
+	memset(p, 1, 4096);
+	EXPECT_TRUE(aligned(p, alignof(std::max_align_t)));
+
+	// a large allocation doesn't use up the current slab
+	char *q = static_cast<char*>(a.allocate(1, 1));
+	char *r = static_cast<char*>(a.allocate(1, 1));
+	EXPECT_EQ(q + 1, r);
+
+	a.reset();
+}
+
+TEST(arena, bytes) {
+	arena a(256);
+	EXPECT_EQ(0u, a.bytes());
+
+	a.allocate(3, 1);
+	a.allocate(8);
+	a.allocate(1024);
+	EXPECT_EQ(3u + 8u + 1024u, a.bytes());
+
+	a.reset();
+	EXPECT_EQ(0u, a.bytes());
+}
+
+TEST(arena, mark) {
+	arena a(256);
+
+	a.allocate(8);
+	arena::marker m = a.mark();
+	void *first = a.allocate(8);
+	for (int i = 0; i < 100; i++) a.allocate(64);
+	a.allocate(4096);
+
+	a.release(m);
+	EXPECT_EQ(8u, a.bytes());
+	EXPECT_EQ(first, a.allocate(8));
+
+	a.reset();
+}
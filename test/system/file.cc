@@ -0,0 +1,29 @@
+#include <dejavu/system/file.h>
+#include <gtest/gtest.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+TEST(file, contents) {
+	char path[] = "/tmp/dejavu-file-XXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_NE(-1, fd);
+
+	const char text[] = "var x;\nx = 1;\n";
+	ASSERT_EQ((ssize_t)strlen(text), write(fd, text, strlen(text)));
+	close(fd);
+
+	file_buffer f;
+	EXPECT_EQ(0, f.open_file(path));
+	ASSERT_EQ(strlen(text), size_t(f.end() - f.begin()));
+	EXPECT_EQ(0, memcmp(text, f.begin(), strlen(text)));
+
+	unlink(path);
+}
+
+TEST(file, missing) {
+	file_buffer f;
+	EXPECT_EQ(ENOENT, f.open_file("/tmp/dejavu-file-does-not-exist"));
+}
@@ -1,6 +1,8 @@
 #include <dejavu/system/string.h>
 #include <gtest/gtest.h>
 #include <memory>
+#include <string>
+#include <vector>
 
 static const char t[] = "abcde";
 static const size_t l = sizeof(t) - 1;
@@ -43,3 +45,139 @@ TEST(string, use) {
 
 	str->release();
 }
+
+TEST(string, batch) {
+	string_pool pool;
+
+	pool.begin_batch();
+	string *p1 = pool.intern("hello");
+	p1->retain();
+	string *p2 = pool.intern("world");
+	p2->retain();
+
+	p1->release();
+	p2->release();
+	p2->retain();
+	p2->release();
+	p2->retain();
+
+	EXPECT_EQ(2, pool.size());
+	pool.end_batch();
+	EXPECT_EQ(1, pool.size());
+
+	p2->release();
+	EXPECT_TRUE(pool.empty());
+}
+
+TEST(string, long_batch) {
+	string_pool pool;
+
+	string *kept = pool.intern("kept");
+	kept->retain();
+
+	pool.begin_batch();
+	for (size_t i = 0; i < 4 * string_pool::batch_limit; i++) {
+		std::string name = std::to_string(i);
+		string *s = pool.intern(name.c_str());
+		s->retain();
+		s->release();
+
+		EXPECT_LE(pool.size(), string_pool::batch_limit + 2);
+	}
+
+	kept->release();
+	kept->retain();
+	pool.end_batch();
+	EXPECT_EQ(1, pool.size());
+
+	kept->release();
+	EXPECT_TRUE(pool.empty());
+}
+
+TEST(string, builder) {
+	string_pool pool;
+
+	string *p1 = pool.intern("hello");
+	p1->retain();
+
+	string *b = new (16) string(l);
+	b->capacity = 16;
+	memcpy(b->data, "hello", l);
+
+	EXPECT_EQ(p1, pool.intern(b));
+	EXPECT_EQ(16, b->capacity);
+
+	memcpy(b->data, "world", l);
+	EXPECT_EQ(b, pool.intern(b));
+	EXPECT_EQ(0, b->capacity);
+	EXPECT_EQ(2, pool.size());
+
+	b->retain();
+	b->release();
+	p1->release();
+	EXPECT_TRUE(pool.empty());
+}
+
+TEST(string, temporary) {
+	string_pool pool;
+	arena a;
+
+	string *p1 = pool.intern("hello");
+	p1->retain();
+
+	string *t1 = new (a, l) string(l, "hello");
+	EXPECT_EQ(p1, pool.intern_temporary(t1));
+
+	string *t2 = new (a, l) string(l, "world");
+	string *p2 = pool.intern_temporary(t2);
+	p2->retain();
+	EXPECT_NE(t2, p2);
+	EXPECT_EQ(0, memcmp(p2->data, "world", l));
+	EXPECT_EQ(2, pool.size());
+
+	a.reset();
+	EXPECT_EQ(p2, pool.intern("world"));
+
+	p1->release();
+	p2->release();
+	EXPECT_TRUE(pool.empty());
+}
+
+TEST(string, hash) {
+	std::string prefix(100, 'a');
+	EXPECT_NE(
+		string::compute_hash(101, (prefix + "b").data()),
+		string::compute_hash(101, (prefix + "c").data())
+	);
+	EXPECT_NE(
+		string::compute_hash(101, ("b" + prefix).data()),
+		string::compute_hash(101, ("c" + prefix).data())
+	);
+
+	EXPECT_NE(string::compute_hash(0, ""), string::compute_hash(1, ""));
+}
+
+// removing from the middle of a probe sequence has to leave the rest findable
+TEST(string, remove) {
+	string_pool pool;
+
+	std::vector<string*> strs;
+	for (int i = 0; i < 1000; i++) {
+		std::string name = "name" + std::to_string(i);
+		string *s = pool.intern(name.data(), name.size());
+		s->retain();
+		strs.push_back(s);
+	}
+	EXPECT_EQ(1000, pool.size());
+
+	for (int i = 0; i < 1000; i += 2) strs[i]->release();
+	EXPECT_EQ(500, pool.size());
+
+	for (int i = 1; i < 1000; i += 2) {
+		std::string name = "name" + std::to_string(i);
+		EXPECT_EQ(strs[i], pool.intern(name.data(), name.size()));
+	}
+
+	for (int i = 1; i < 1000; i += 2) strs[i]->release();
+	EXPECT_TRUE(pool.empty());
+}
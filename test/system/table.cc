@@ -89,3 +89,80 @@ TEST(table, subscript) {
 	EXPECT_EQ(2, t[5]);
 	EXPECT_EQ(3, t[7]);
 }
+
+TEST(table, capacity) {
+	table<int, int> t(3);
+	EXPECT_EQ(4u, t.capacity());
+
+	t.reserve(9);
+	EXPECT_EQ(16u, t.capacity());
+
+	t.reserve(2);
+	EXPECT_EQ(16u, t.capacity());
+}
+
+TEST(table, reserve) {
+	table<int, int> t;
+
+	t[1] = 1;
+	t[2] = 2;
+	t.reserve(100);
+
+	EXPECT_EQ(2u, t.size());
+	EXPECT_EQ(1, t.find(1)->v);
+	EXPECT_EQ(2, t.find(2)->v);
+	EXPECT_EQ(t.end(), t.find(0));
+}
+
+// removing the end of a chain has to unlink it, or find would keep going
+TEST(table, remove_tail) {
+	table<int, int> t(4);
+
+	t.insert(1) = 1;
+	t.insert(5) = 2;
+	t.insert(9) = 3;
+
+	t.remove(9);
+	EXPECT_EQ(t.end(), t.find(9));
+	t.remove(5);
+	EXPECT_EQ(t.end(), t.find(5));
+	EXPECT_EQ(1, t.find(1)->v);
+
+	t.insert(13) = 4;
+	EXPECT_EQ(4, t.find(13)->v);
+	EXPECT_EQ(2u, t.size());
+}
+
+TEST(table, small) {
+	table<int, int, hash<int>, equal<int>, 4> t;
+	EXPECT_EQ(4u, t.capacity());
+
+	for (int i = 0; i < 4; i++) t[i * 4] = i;
+	EXPECT_EQ(4u, t.capacity());
+	for (int i = 0; i < 4; i++) EXPECT_EQ(i, t.find(i * 4)->v);
+
+	t.remove(8);
+	EXPECT_EQ(t.end(), t.find(8));
+
+	for (int i = 0; i < 16; i++) t[i] = i;
+	EXPECT_EQ(16u, t.size());
+	for (int i = 0; i < 16; i++) EXPECT_EQ(i, t.find(i)->v);
+}
+
+TEST(table, nodes) {
+	table<int, int> t;
+	for (int i = 0; i < 10; i++) t[i] = i * 2;
+	t.remove(3);
+
+	int seen = 0, sum = 0;
+	for (table<int, int>::node &n : t.nodes()) {
+		EXPECT_EQ(n.k * 2, n.v);
+		seen++;
+		sum += n.k;
+	}
+	EXPECT_EQ(9, seen);
+	EXPECT_EQ(45 - 3, sum);
+
+	table<int, int, hash<int>, equal<int>, 4> empty;
+	for (auto &n : empty.nodes()) ADD_FAILURE() << n.k;
+}